@@ -0,0 +1,700 @@
+/*
+ * Duktape 引擎基準測試 (不需要 Harbour): 直接連結 duktape.c, 以 JSON 輸出結果
+ *
+ *   bench_engine [-w 預熱次數] [-r 重複次數] [-s 次數倍率] [-f 名稱過濾] [-o 輸出文件] [-l]
+ *                [-b 基準文件 [-c 比較文件] [-t 容許百分比]]
+ *
+ * 每個項目先建立自己的 heap 與資料 (不計時), 預熱後重複執行 r 次,
+ * 每次執行固定的操作數; 結果為每次操作的奈秒數及其統計值.
+ * 操作數固定 (可用 -s 等比例調整), 不同建置的結果可直接比較.
+ *
+ * -b 以中位數與先前的結果比較, 任一項目變慢超過 -t (預設 10%) 時退出碼為 1;
+ * 加上 -c 時不執行測試, 只比較兩個文件 (bench_binding 的輸出格式相同, 也可比較).
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "duktape.h"
+
+#define BENCH_MAX_REPS  1000
+#define BENCH_MAX_COUNT 64
+#define BENCH_KEYS      10000
+
+typedef struct
+{
+   const char *name;
+   const char *desc;
+   long        nOps;                               /* 每次重複的操作數 (未乘倍率) */
+   void      (*setup)(duk_context *ctx);           /* 不計時, 可為 NULL */
+   void      (*body)(duk_context *ctx, long nOps); /* 執行 nOps 次操作 */
+} BENCH;
+
+static char *s_keys[BENCH_KEYS];
+
+static double bench_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench_fatal(duk_context *ctx, const char *where)
+{
+   fprintf(stderr, "bench_engine: %s: %s\n", where, duk_safe_to_string(ctx, -1));
+   exit(1);
+}
+
+/* 執行代碼並丟棄結果, 錯誤時中止 */
+static void bench_eval(duk_context *ctx, const char *code)
+{
+   if (duk_peval_string(ctx, code) != 0)
+   {
+      bench_fatal(ctx, code);
+   }
+   duk_pop(ctx);
+}
+
+/* 以數字參數調用全局函數 */
+static void bench_call_global(duk_context *ctx, const char *name, long nArg)
+{
+   duk_get_global_string(ctx, name);
+   duk_push_number(ctx, (double)nArg);
+   if (duk_pcall(ctx, 1) != 0)
+   {
+      bench_fatal(ctx, name);
+   }
+   duk_pop(ctx);
+}
+
+/* ---- eval ---- */
+
+static void body_eval_small(duk_context *ctx, long nOps)
+{
+   long i;
+
+   for (i = 0; i < nOps; i++)
+   {
+      if (duk_peval_string(ctx, "var a = 1 + 2 * 3; a") != 0)
+      {
+         bench_fatal(ctx, "eval_small");
+      }
+      duk_pop(ctx);
+   }
+}
+
+static const char *s_script =
+   "(function () {\n"
+   "   function Point(x, y) { this.x = x; this.y = y; }\n"
+   "   Point.prototype.len = function () { return Math.sqrt(this.x * this.x + this.y * this.y); };\n"
+   "   var pts = [], sum = 0, i;\n"
+   "   for (i = 0; i < 50; i++) { pts.push(new Point(i, i + 1)); }\n"
+   "   for (i = 0; i < pts.length; i++) { sum += pts[i].len(); }\n"
+   "   var o = { name: 'x', tags: ['a', 'b'], nested: { v: sum } };\n"
+   "   return JSON.stringify(o).length;\n"
+   "})()";
+
+static void body_eval_script(duk_context *ctx, long nOps)
+{
+   long i;
+
+   for (i = 0; i < nOps; i++)
+   {
+      if (duk_peval_string(ctx, s_script) != 0)
+      {
+         bench_fatal(ctx, "eval_script");
+      }
+      duk_pop(ctx);
+   }
+}
+
+/* ---- 函數調用 ---- */
+
+static void setup_call(duk_context *ctx)
+{
+   bench_eval(ctx, "function add(a, b) { return a + b; }");
+}
+
+static void body_call_js_from_c(duk_context *ctx, long nOps)
+{
+   long i;
+
+   for (i = 0; i < nOps; i++)
+   {
+      duk_get_global_string(ctx, "add");
+      duk_push_int(ctx, (duk_int_t)i);
+      duk_push_int(ctx, 1);
+      if (duk_pcall(ctx, 2) != 0)
+      {
+         bench_fatal(ctx, "call_js_from_c");
+      }
+      duk_pop(ctx);
+   }
+}
+
+static duk_ret_t native_add(duk_context *ctx)
+{
+   duk_push_number(ctx, duk_get_number(ctx, 0) + duk_get_number(ctx, 1));
+   return 1;
+}
+
+static void setup_call_c(duk_context *ctx)
+{
+   duk_push_c_function(ctx, native_add, 2);
+   duk_put_global_string(ctx, "nativeAdd");
+   bench_eval(ctx, "function callNative(n) { var s = 0; for (var i = 0; i < n; i++) s = nativeAdd(s, 1); return s; }"
+                   "function callJs(n) { var s = 0; for (var i = 0; i < n; i++) s = add(s, 1); return s; }"
+                   "function add(a, b) { return a + b; }");
+}
+
+static void body_call_c_from_js(duk_context *ctx, long nOps)
+{
+   bench_call_global(ctx, "callNative", nOps);
+}
+
+static void body_call_js_from_js(duk_context *ctx, long nOps)
+{
+   bench_call_global(ctx, "callJs", nOps);
+}
+
+/* ---- 大型陣列與對象的推入/讀取 ---- */
+
+static void setup_marshal(duk_context *ctx)
+{
+   int i;
+
+   (void)ctx;
+   for (i = 0; i < BENCH_KEYS; i++)
+   {
+      if (s_keys[i] == NULL)
+      {
+         s_keys[i] = (char *)malloc(16);
+         sprintf(s_keys[i], "key%d", i);
+      }
+   }
+}
+
+static void body_array_push(duk_context *ctx, long nOps)
+{
+   long n;
+   duk_uarridx_t i;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_push_array(ctx);
+      for (i = 0; i < BENCH_KEYS; i++)
+      {
+         duk_push_number(ctx, (double)i);
+         duk_put_prop_index(ctx, -2, i);
+      }
+      duk_pop(ctx);
+   }
+}
+
+static void setup_array_read(duk_context *ctx)
+{
+   bench_eval(ctx, "var bigArray = []; for (var i = 0; i < 10000; i++) bigArray.push(i * 0.5);");
+}
+
+static void body_array_read(duk_context *ctx, long nOps)
+{
+   long n;
+   duk_uarridx_t i, len;
+   double sum = 0;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_get_global_string(ctx, "bigArray");
+      len = (duk_uarridx_t)duk_get_length(ctx, -1);
+      for (i = 0; i < len; i++)
+      {
+         duk_get_prop_index(ctx, -1, i);
+         sum += duk_get_number(ctx, -1);
+         duk_pop(ctx);
+      }
+      duk_pop(ctx);
+   }
+   if (sum < 0)
+   {
+      puts("");
+   }
+}
+
+static void body_object_push(duk_context *ctx, long nOps)
+{
+   long n;
+   int i;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_push_object(ctx);
+      for (i = 0; i < BENCH_KEYS; i++)
+      {
+         duk_push_int(ctx, i);
+         duk_put_prop_string(ctx, -2, s_keys[i]);
+      }
+      duk_pop(ctx);
+   }
+}
+
+static void setup_object_read(duk_context *ctx)
+{
+   setup_marshal(ctx);
+   bench_eval(ctx, "var bigObject = {}; for (var i = 0; i < 10000; i++) bigObject['key' + i] = i;");
+}
+
+static void body_object_read(duk_context *ctx, long nOps)
+{
+   long n;
+   double sum = 0;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_get_global_string(ctx, "bigObject");
+      duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+      while (duk_next(ctx, -1, 1))
+      {
+         sum += duk_get_number(ctx, -1);
+         duk_pop_2(ctx);
+      }
+      duk_pop_2(ctx);
+   }
+   if (sum < 0)
+   {
+      puts("");
+   }
+}
+
+/* ---- JSON ---- */
+
+static void setup_json(duk_context *ctx)
+{
+   bench_eval(ctx, "var records = [];"
+                   "for (var i = 0; i < 1000; i++) records.push({ id: i, name: 'item' + i, price: i * 1.25,"
+                   " tags: ['a', 'b', 'c'], active: (i % 2) === 0, meta: { created: '2024-01-01', rev: i } });"
+                   "var recordsJson = JSON.stringify(records);");
+}
+
+static void body_json_stringify(duk_context *ctx, long nOps)
+{
+   long n;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_get_global_string(ctx, "records");
+      duk_json_encode(ctx, -1);
+      duk_pop(ctx);
+   }
+}
+
+static void body_json_parse(duk_context *ctx, long nOps)
+{
+   long n;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_get_global_string(ctx, "recordsJson");
+      duk_json_decode(ctx, -1);
+      duk_pop(ctx);
+   }
+}
+
+/* ---- 正則表達式與字串 ---- */
+
+static void setup_text(duk_context *ctx)
+{
+   bench_eval(ctx, "var mails = []; for (var i = 0; i < 100; i++) mails.push('user' + i + ' <name' + i + '@host' + (i % 7) + '.com> ok');"
+                   "function regexpRun(n) { var re = /(\\w+)@(\\w+)\\.com/, hits = 0;"
+                   "  for (var i = 0; i < n; i++) { if (re.exec(mails[i % 100])) hits++; } return hits; }"
+                   "function concatRun(n) { var len = 0; for (var k = 0; k < n; k++) {"
+                   "  var s = ''; for (var i = 0; i < 100; i++) s += 'piece' + i + ';'; len += s.length; } return len; }"
+                   "function joinRun(n) { var len = 0; for (var k = 0; k < n; k++) {"
+                   "  var a = []; for (var i = 0; i < 100; i++) a.push('piece' + i); len += a.join(';').length; } return len; }");
+}
+
+static void body_regexp(duk_context *ctx, long nOps)
+{
+   bench_call_global(ctx, "regexpRun", nOps);
+}
+
+static void body_string_concat(duk_context *ctx, long nOps)
+{
+   bench_call_global(ctx, "concatRun", nOps);
+}
+
+static void body_string_join(duk_context *ctx, long nOps)
+{
+   bench_call_global(ctx, "joinRun", nOps);
+}
+
+/* ---- 垃圾回收與 heap ---- */
+
+static void setup_gc(duk_context *ctx)
+{
+   bench_eval(ctx, "var live = []; for (var i = 0; i < 100000; i++) live.push({ i: i, s: 'v' + (i % 1000) });");
+}
+
+static void body_gc_full(duk_context *ctx, long nOps)
+{
+   long n;
+
+   for (n = 0; n < nOps; n++)
+   {
+      duk_gc(ctx, 0);
+   }
+}
+
+static void body_heap_create_destroy(duk_context *ctx, long nOps)
+{
+   long n;
+
+   (void)ctx;
+   for (n = 0; n < nOps; n++)
+   {
+      duk_context *c = duk_create_heap_default();
+
+      if (c == NULL)
+      {
+         fprintf(stderr, "bench_engine: duk_create_heap_default failed\n");
+         exit(1);
+      }
+      duk_destroy_heap(c);
+   }
+}
+
+static const BENCH s_benches[] =
+{
+   { "eval_small",          "compile and run a one-line eval",                 20000, NULL,              body_eval_small },
+   { "eval_script",         "compile and run a 9-line script",                  2000, NULL,              body_eval_script },
+   { "call_js_from_c",      "duk_pcall of a global JS function with 2 args",  200000, setup_call,        body_call_js_from_c },
+   { "call_c_from_js",      "JS loop calling a native function",               500000, setup_call_c,      body_call_c_from_js },
+   { "call_js_from_js",     "JS loop calling a JS function",                   500000, setup_call_c,      body_call_js_from_js },
+   { "array_push_10k",      "build a 10000-element array from C",                 200, setup_marshal,     body_array_push },
+   { "array_read_10k",      "read a 10000-element array from C",                  200, setup_array_read,  body_array_read },
+   { "object_push_10k",     "build a 10000-key object from C",                    100, setup_marshal,     body_object_push },
+   { "object_read_10k",     "enumerate a 10000-key object from C",                100, setup_object_read, body_object_read },
+   { "json_stringify_1k",   "JSON encode 1000 records",                           100, setup_json,        body_json_stringify },
+   { "json_parse_1k",       "JSON decode 1000 records",                           100, setup_json,        body_json_parse },
+   { "regexp_exec",         "RegExp exec on short strings",                     50000, setup_text,        body_regexp },
+   { "string_concat_100",   "build a string from 100 pieces with +=",           5000, setup_text,        body_string_concat },
+   { "string_join_100",     "build a string from 100 pieces with join",         5000, setup_text,        body_string_join },
+   { "gc_full_100k",        "full mark-and-sweep with 100000 live objects",        20, setup_gc,          body_gc_full },
+   { "heap_create_destroy", "duk_create_heap_default + duk_destroy_heap",        200, NULL,              body_heap_create_destroy },
+};
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void bench_json_string(FILE *fp, const char *s)
+{
+   fputc('"', fp);
+   for (; *s; s++)
+   {
+      if (*s == '"' || *s == '\\')
+      {
+         fputc('\\', fp);
+      }
+      fputc(*s, fp);
+   }
+   fputc('"', fp);
+}
+
+/* 讀取 JSON 文件並推入解析結果 */
+static int bench_load_json(duk_context *ctx, const char *szFile)
+{
+   FILE *f = fopen(szFile, "rb");
+   char *buf;
+   long len;
+
+   if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0)
+   {
+      fprintf(stderr, "bench_engine: cannot read %s\n", szFile);
+      if (f != NULL)
+      {
+         fclose(f);
+      }
+      return 0;
+   }
+   rewind(f);
+   buf = (char *)malloc((size_t)len + 1);
+   len = (long)fread(buf, 1, (size_t)len, f);
+   fclose(f);
+
+   duk_get_global_string(ctx, "JSON");
+   duk_get_prop_string(ctx, -1, "parse");
+   duk_push_lstring(ctx, buf, (duk_size_t)len);
+   free(buf);
+   if (duk_pcall(ctx, 1) != 0 || !duk_is_object(ctx, -1))
+   {
+      fprintf(stderr, "bench_engine: %s: invalid JSON\n", szFile);
+      duk_pop_2(ctx);
+      return 0;
+   }
+   duk_remove(ctx, -2);
+   return 1;
+}
+
+/* 取出 results 陣列中的名稱及中位數, 字串由堆疊上的對象持有 */
+static int bench_read_results(duk_context *ctx, duk_idx_t idx, const char **names, double *medians)
+{
+   duk_uarridx_t i, len;
+   int n = 0;
+
+   duk_get_prop_string(ctx, idx, "results");
+   len = (duk_uarridx_t)duk_get_length(ctx, -1);
+   for (i = 0; i < len && n < BENCH_MAX_COUNT; i++)
+   {
+      duk_get_prop_index(ctx, -1, i);
+      duk_get_prop_string(ctx, -1, "name");
+      duk_get_prop_string(ctx, -2, "median");
+      if (duk_is_string(ctx, -2) && duk_is_number(ctx, -1))
+      {
+         names[n] = duk_get_string(ctx, -2);
+         medians[n] = duk_get_number(ctx, -1);
+         n++;
+      }
+      duk_pop_3(ctx);
+   }
+   duk_pop(ctx);
+   return n;
+}
+
+/* 以中位數比較, 返回變慢超過 dThreshold 百分比的項目數 */
+static int bench_compare(const char *szBase, const char *szCur, const char **names, const double *medians, int n,
+                         double dThreshold)
+{
+   const char *baseNames[BENCH_MAX_COUNT], *curNames[BENCH_MAX_COUNT];
+   double baseMedians[BENCH_MAX_COUNT], curMedians[BENCH_MAX_COUNT];
+   duk_context *ctx = duk_create_heap_default();
+   int nBase, i, j, iSlower = 0;
+
+   if (ctx == NULL || !bench_load_json(ctx, szBase))
+   {
+      exit(1);
+   }
+   nBase = bench_read_results(ctx, -1, baseNames, baseMedians);
+   if (szCur != NULL)
+   {
+      if (!bench_load_json(ctx, szCur))
+      {
+         exit(1);
+      }
+      n = bench_read_results(ctx, -1, curNames, curMedians);
+      names = curNames;
+      medians = curMedians;
+   }
+
+   fprintf(stderr, "%-22s %14s %14s %9s\n", "benchmark", "base ns/op", "new ns/op", "change");
+   for (i = 0; i < n; i++)
+   {
+      for (j = 0; j < nBase && strcmp(baseNames[j], names[i]) != 0; j++)
+      {
+      }
+      if (j == nBase || baseMedians[j] <= 0)
+      {
+         fprintf(stderr, "%-22s %14s %14.1f %9s\n", names[i], "-", medians[i], "new");
+         continue;
+      }
+      {
+         double dChange = (medians[i] - baseMedians[j]) * 100 / baseMedians[j];
+         int fSlower = dChange > dThreshold;
+
+         fprintf(stderr, "%-22s %14.1f %14.1f %+8.1f%%%s\n", names[i], baseMedians[j], medians[i], dChange,
+                 fSlower ? "  SLOWER" : (dChange < -dThreshold ? "  faster" : ""));
+         iSlower += fSlower;
+      }
+   }
+   duk_destroy_heap(ctx);
+   return iSlower;
+}
+
+static void bench_usage(void)
+{
+   fprintf(stderr, "usage: bench_engine [-w warmup] [-r repetitions] [-s scale] [-f filter] [-o file.json] [-l]\n"
+                   "                    [-b baseline.json [-c current.json] [-t percent]]\n");
+   exit(2);
+}
+
+int main(int argc, char **argv)
+{
+   int iWarmup = 3, iReps = 10, fList = 0, fFirst = 1;
+   double dScale = 1.0, dThreshold = 10.0;
+   const char *szFilter = NULL, *szOut = NULL, *szBase = NULL, *szCur = NULL;
+   const char *names[BENCH_MAX_COUNT];
+   double medians[BENCH_MAX_COUNT];
+   FILE *fp = stdout;
+   size_t b;
+   int i, n = 0;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-l") == 0)
+      {
+         fList = 1;
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-w") == 0)
+      {
+         iWarmup = atoi(argv[++i]);
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+      {
+         iReps = atoi(argv[++i]);
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+      {
+         dScale = atof(argv[++i]);
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-f") == 0)
+      {
+         szFilter = argv[++i];
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+      {
+         szOut = argv[++i];
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-b") == 0)
+      {
+         szBase = argv[++i];
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-c") == 0)
+      {
+         szCur = argv[++i];
+      }
+      else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+      {
+         dThreshold = atof(argv[++i]);
+      }
+      else
+      {
+         bench_usage();
+      }
+   }
+   if (iWarmup < 0 || iReps < 1 || iReps > BENCH_MAX_REPS || dScale <= 0 || (szCur != NULL && szBase == NULL))
+   {
+      bench_usage();
+   }
+
+   if (szCur != NULL)
+   {
+      return bench_compare(szBase, szCur, NULL, NULL, 0, dThreshold) ? 1 : 0;
+   }
+
+   if (fList)
+   {
+      for (b = 0; b < sizeof(s_benches) / sizeof(s_benches[0]); b++)
+      {
+         printf("%-22s %s\n", s_benches[b].name, s_benches[b].desc);
+      }
+      return 0;
+   }
+
+   if (szOut != NULL && (fp = fopen(szOut, "w")) == NULL)
+   {
+      fprintf(stderr, "bench_engine: cannot write %s\n", szOut);
+      return 1;
+   }
+
+   fprintf(fp, "{\n  \"suite\": \"engine\",\n  \"duktape_version\": %ld,\n  \"timestamp\": %ld,\n",
+           (long)DUK_VERSION, (long)time(NULL));
+#if defined(__VERSION__)
+   fprintf(fp, "  \"compiler\": ");
+   bench_json_string(fp, __VERSION__);
+   fprintf(fp, ",\n");
+#endif
+#if defined(DUK_USE_HB_OPCODE_STATS)
+   fprintf(fp, "  \"opcode_stats\": true,\n");
+#else
+   fprintf(fp, "  \"opcode_stats\": false,\n");
+#endif
+   fprintf(fp, "  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"scale\": %g,\n  \"unit\": \"ns/op\",\n  \"results\": [",
+           iWarmup, iReps, dScale);
+
+   for (b = 0; b < sizeof(s_benches) / sizeof(s_benches[0]); b++)
+   {
+      const BENCH *pBench = &s_benches[b];
+      double samples[BENCH_MAX_REPS], sorted[BENCH_MAX_REPS];
+      double dSum = 0, dVar = 0, dMean, dMedian, dStddev;
+      long nOps = (long)(pBench->nOps * dScale);
+      duk_context *ctx;
+
+      if (szFilter != NULL && strstr(pBench->name, szFilter) == NULL)
+      {
+         continue;
+      }
+      if (nOps < 1)
+      {
+         nOps = 1;
+      }
+      fprintf(stderr, "%s...\n", pBench->name);
+
+      ctx = duk_create_heap_default();
+      if (ctx == NULL)
+      {
+         fprintf(stderr, "bench_engine: duk_create_heap_default failed\n");
+         return 1;
+      }
+      if (pBench->setup != NULL)
+      {
+         pBench->setup(ctx);
+      }
+      for (i = 0; i < iWarmup; i++)
+      {
+         pBench->body(ctx, nOps);
+      }
+      for (i = 0; i < iReps; i++)
+      {
+         double t0 = bench_now_ns();
+
+         pBench->body(ctx, nOps);
+         samples[i] = (bench_now_ns() - t0) / (double)nOps;
+         dSum += samples[i];
+      }
+      duk_destroy_heap(ctx);
+
+      dMean = dSum / iReps;
+      for (i = 0; i < iReps; i++)
+      {
+         dVar += (samples[i] - dMean) * (samples[i] - dMean);
+         sorted[i] = samples[i];
+      }
+      dStddev = iReps > 1 ? sqrt(dVar / (iReps - 1)) : 0;
+      qsort(sorted, (size_t)iReps, sizeof(double), bench_cmp_double);
+      dMedian = (iReps % 2) ? sorted[iReps / 2] : (sorted[iReps / 2 - 1] + sorted[iReps / 2]) / 2;
+
+      fprintf(fp, "%s\n    { \"name\": ", fFirst ? "" : ",");
+      bench_json_string(fp, pBench->name);
+      fprintf(fp, ", \"desc\": ");
+      bench_json_string(fp, pBench->desc);
+      fprintf(fp, ", \"ops\": %ld,\n      \"mean\": %.3f, \"median\": %.3f, \"min\": %.3f, \"max\": %.3f,"
+                  " \"stddev\": %.3f, \"cv\": %.4f,\n      \"samples\": [",
+              nOps, dMean, dMedian, sorted[0], sorted[iReps - 1], dStddev, dMean > 0 ? dStddev / dMean : 0);
+      for (i = 0; i < iReps; i++)
+      {
+         fprintf(fp, "%s%.3f", i ? ", " : "", samples[i]);
+      }
+      fprintf(fp, "] }");
+      fFirst = 0;
+      names[n] = pBench->name;
+      medians[n++] = dMedian;
+   }
+   fprintf(fp, "\n  ]\n}\n");
+
+   if (fp != stdout)
+   {
+      fclose(fp);
+   }
+   if (szBase != NULL)
+   {
+      return bench_compare(szBase, NULL, names, medians, n, dThreshold) ? 1 : 0;
+   }
+   return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+# 建置並執行基準測試, 結果寫入 bench_engine.json 與 bench_binding.json
+#
+#   ./build.sh [-w N] [-r N] [-s N] [-f 名稱]    選項傳給兩個驅動程式, 例如 ./build.sh -r 20 -f json
+#   ./bench_engine -b 舊.json -c bench_binding.json    與先前的結果比較
+#   CFLAGS="-O2 -DHB_DUK_OPCODE_STATS" ./build.sh
+set -e
+cd "$(dirname "$0")"
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+# 編譯引擎驅動程式 (只需要 duktape.c)
+echo "Building bench_engine..." >&2
+$CC $CFLAGS -std=c99 -I.. -o bench_engine bench_engine.c ../duktape.c -lm
+
+# 使用 hbmk2 編譯綁定驅動程式
+if command -v hbmk2 >/dev/null 2>&1; then
+   echo "Building bench_binding..." >&2
+   hbmk2 bench.hbp
+else
+   echo "hbmk2 not found, skipping bench_binding" >&2
+fi
+
+./bench_engine -o bench_engine.json "$@"
+if [ -x ./bench_binding ]; then
+   ./bench_binding -o bench_binding.json "$@"
+fi
+
+echo "Benchmarks completed successfully!" >&2
@@ -9,7 +9,7 @@ set PATH=%HB_ROOT%\bin\win\bcc;%BCC_ROOT%\bin;%PATH%
 
 :: 編譯 Duktape 函式庫
 echo Building Duktape library...
-bcc32 -c -I. duktape.c
+bcc32 -c -I. -DHB_DUK_BINDING duktape.c
 tlib duktape.lib + duktape.obj
 
 :: 使用 hbmk2 編譯
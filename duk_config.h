@@ -3102,6 +3102,67 @@ typedef struct duk_hthread duk_context;
 
 /* __OVERRIDE_DEFINES__ */
 
+/* Harbour binding hooks.  These call back into duktape_core.c, so they are
+ * only enabled when building for the binding (-DHB_DUK_BINDING, set in
+ * duktape.hbp); duktape.c built on its own links without the binding.
+ */
+#if defined(HB_DUK_BINDING)
+
+/* Harbour binding: per-heap execution deadline and cancellation.  The
+ * heap udata is the binding's heap record, see duktape_core.c.
+ */
+#define DUK_USE_INTERRUPT_COUNTER
+#define DUK_USE_EXEC_TIMEOUT_CHECK(udata) hb_duk_exec_timeout_check((udata))
+extern duk_bool_t hb_duk_exec_timeout_check(void *udata);
+
+/* Harbour binding: cooperative task switching (DUK_TASK_RUN).  Called at the
+ * end of each executor interrupt; the binding may suspend the running task
+ * there when its time slice is used up.
+ */
+#define DUK_USE_HB_EXEC_YIELD(udata,thr) hb_duk_exec_yield((udata), (thr))
+extern void hb_duk_exec_yield(void *udata, void *thr);
+
+/* Harbour binding: sampling profiler (DUK_PROFILE_START).  Called from each
+ * executor interrupt; the binding records the call stack there through
+ * duk_hb_sample_callstack().
+ */
+#define DUK_USE_HB_EXEC_SAMPLE(udata,thr) hb_duk_exec_sample((udata), (thr))
+extern void hb_duk_exec_sample(void *udata, void *thr);
+
+/* Harbour binding: executed opcode histogram and per-function instruction
+ * counters (DUK_EXEC_STATS).  Adds two counter updates per dispatched
+ * instruction, so it is only compiled in when building with
+ * -DHB_DUK_OPCODE_STATS; otherwise the executor is unchanged.
+ */
+#if defined(HB_DUK_OPCODE_STATS)
+#define DUK_USE_HB_OPCODE_STATS
+#endif
+
+/* Harbour binding: mark-and-sweep pause/refzero counters and heap population
+ * stats, exposed through duk_hb_get_gc_stats().
+ */
+#define DUK_USE_HB_GC_STATS
+
+/* Harbour binding: notify the binding when an external buffer is freed so
+ * the Harbour string backing it (DUK_PUSH_BUFFER_VIEW) can be unpinned.
+ */
+#define DUK_USE_HB_EXTBUF_FREE(udata,ptr) hb_duk_extbuf_free((udata), (ptr))
+extern void hb_duk_extbuf_free(void *udata, const void *ptr);
+
+#endif  /* HB_DUK_BINDING */
+
+/* Harbour binding: optional external strings, long Harbour strings are
+ * referenced in place instead of copied (DUK_EXTERNAL_STRINGS).  Opt-in
+ * because every string free then goes through the binding's hook.
+ */
+#if defined(HB_DUK_BINDING) && defined(HB_DUK_EXTSTR)
+#define DUK_USE_HSTRING_EXTDATA
+#define DUK_USE_EXTSTR_INTERN_CHECK(udata,ptr,len) hb_duk_extstr_intern_check((udata), (ptr), (len))
+#define DUK_USE_EXTSTR_FREE(udata,ptr) hb_duk_extstr_free((udata), (ptr))
+extern void *hb_duk_extstr_intern_check(void *udata, void *ptr, duk_size_t len);
+extern void hb_duk_extstr_free(void *udata, const void *ptr);
+#endif
+
 /*
  *  Conditional includes
  */
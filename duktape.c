@@ -7747,6 +7747,11 @@ struct duk_hcompfunc {
 	duk_uint16_t nregs; /* regs to allocate */
 	duk_uint16_t nargs; /* number of arguments allocated to regs */
 
+#if defined(DUK_USE_HB_OPCODE_STATS)
+	/* Harbour binding: instructions executed in this function. */
+	duk_uint64_t hb_inst_count;
+#endif
+
 	/*
 	 *  Additional control information is placed into the object itself
 	 *  as internal properties to avoid unnecessary fields for the
@@ -9549,6 +9554,20 @@ struct duk_heap {
 #endif
 #endif
 
+#if defined(DUK_USE_HB_GC_STATS)
+	/* Harbour binding GC statistics, see duk_hb_get_gc_stats(). */
+	duk_uint_t hb_ms_count;
+	duk_double_t hb_ms_time_total;
+	duk_double_t hb_ms_time_max;
+	duk_size_t hb_refzero_free_count;
+#endif
+
+#if defined(DUK_USE_HB_OPCODE_STATS)
+	/* Harbour binding executed opcode counts, see duk_hb_push_exec_stats(). */
+	duk_uint64_t hb_op_count[256];
+	duk_uint64_t hb_inst_collected; /* counts of freed functions */
+#endif
+
 	/* Stats. */
 #if defined(DUK_USE_DEBUG)
 	duk_int_t stats_exec_opcodes;
@@ -10409,7 +10428,7 @@ DUK_INTERNAL_DECL duk_bool_t duk_fb_is_full(duk_fixedbuffer *fb);
 	} while (0)
 #define DUK_ERROR_ALLOC_FAILED(thr) \
 	do { \
-		duk_err_error((thr)); \
+		duk_err_range((thr)); \
 	} while (0)
 #define DUK_ERROR_UNSUPPORTED(thr) \
 	do { \
@@ -12541,7 +12560,8 @@ DUK_INTERNAL DUK_COLD void duk_err_error_internal(duk_hthread *thr, const char *
 	DUK_ERROR_RAW(thr, filename, linenumber, DUK_ERR_ERROR, DUK_STR_INTERNAL_ERROR);
 }
 DUK_INTERNAL DUK_COLD void duk_err_error_alloc_failed(duk_hthread *thr, const char *filename, duk_int_t linenumber) {
-	DUK_ERROR_RAW(thr, filename, linenumber, DUK_ERR_ERROR, DUK_STR_ALLOC_FAILED);
+	/* RangeError so that heap memory limit violations are catchable as such. */
+	DUK_ERROR_RAW(thr, filename, linenumber, DUK_ERR_RANGE_ERROR, DUK_STR_ALLOC_FAILED);
 }
 DUK_INTERNAL DUK_COLD void duk_err_error(duk_hthread *thr, const char *filename, duk_int_t linenumber, const char *message) {
 	DUK_ERROR_RAW(thr, filename, linenumber, DUK_ERR_ERROR, message);
@@ -15188,6 +15208,154 @@ DUK_EXTERNAL void duk_load_function(duk_hthread *thr) {
 
 #endif /* DUK_USE_BYTECODE_DUMP_SUPPORT */
 
+/*
+ *  Harbour binding: duk_dump_function() does not serialize a function's
+ *  lexical environment and duk_load_function() binds the loaded function
+ *  to the global environment.  Pushes the environment records between a
+ *  compiled function and the global environment, innermost first, and
+ *  returns their count.  The record holding only the function's own name
+ *  (named function expression) is skipped, duk_load_function() recreates
+ *  it.  Zero means a dump/load round trip keeps the function intact;
+ *  values other than compiled functions push nothing.
+ */
+
+DUK_EXTERNAL duk_idx_t duk_hb_push_scope_records(duk_hthread *thr, duk_idx_t idx) {
+	duk_hobject *h;
+	duk_hobject *env;
+	duk_hobject *global_env;
+	duk_idx_t count = 0;
+
+	DUK_ASSERT_API_ENTRY(thr);
+
+	h = duk_get_hobject(thr, idx);
+	if (h == NULL || !DUK_HOBJECT_IS_COMPFUNC(h)) {
+		return 0;
+	}
+
+	global_env = thr->builtins[DUK_BIDX_GLOBAL_ENV];
+	env = DUK_HCOMPFUNC_GET_LEXENV(thr->heap, (duk_hcompfunc *) h);
+	if (env != NULL && env != global_env && DUK_HOBJECT_HAS_NAMEBINDING(h)) {
+		env = DUK_HOBJECT_GET_PROTOTYPE(thr->heap, env);
+	}
+	for (; env != NULL && env != global_env; env = DUK_HOBJECT_GET_PROTOTYPE(thr->heap, env)) {
+		duk_require_stack(thr, 1);
+		duk_push_hobject(thr, env);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ *  Harbour binding: checkpoint restore for DUK_RESET.  The array at rec_idx
+ *  holds [ key, flags, value, setter, ... ] with four slots per property:
+ *  the DUK_DEFPROP_WEC attributes plus DUK_PROPDESC_FLAG_ACCESSOR, then the
+ *  value, or the getter and setter of an accessor.  Makes each own property
+ *  of the object at obj_idx match its entry, even if it is no longer
+ *  configurable.  Properties that already match are left alone, so virtual
+ *  properties (array 'length', string indices) are only written when they
+ *  really differ.  Returns how many real own properties the object has that
+ *  are not in the record; the caller deletes those.
+ */
+
+DUK_EXTERNAL duk_size_t duk_hb_restore_props(duk_hthread *thr, duk_idx_t obj_idx, duk_idx_t rec_idx) {
+	duk_hobject *obj;
+	duk_hstring *key;
+	duk_propdesc desc;
+	duk_uint_t flags;
+	duk_bool_t accessor;
+	duk_bool_t same;
+	duk_size_t n, i;
+	duk_size_t matched = 0;
+	duk_size_t count = 0;
+
+	DUK_ASSERT_API_ENTRY(thr);
+
+	obj_idx = duk_require_normalize_index(thr, obj_idx);
+	rec_idx = duk_require_normalize_index(thr, rec_idx);
+	obj = duk_require_hobject(thr, obj_idx);
+	n = duk_get_length(thr, rec_idx);
+
+	for (i = 0; i + 3 < n; i += 4) {
+		duk_get_prop_index(thr, rec_idx, (duk_uarridx_t) i);
+		key = duk_to_property_key_hstring(thr, -1);
+		duk_get_prop_index(thr, rec_idx, (duk_uarridx_t) (i + 1));
+		flags = (duk_uint_t) duk_get_uint(thr, -1);
+		duk_pop_unsafe(thr);
+		accessor = (flags & DUK_PROPDESC_FLAG_ACCESSOR) != 0;
+		duk_get_prop_index(thr, rec_idx, (duk_uarridx_t) (i + 2));
+		if (accessor) {
+			duk_get_prop_index(thr, rec_idx, (duk_uarridx_t) (i + 3));
+		}
+
+		/* [ ... key value current ] or [ ... key getter setter undefined ] */
+		same = 0;
+		if (duk_hobject_get_own_propdesc(thr, obj, key, &desc, DUK_GETDESC_FLAG_PUSH_VALUE)) {
+			if (desc.e_idx >= 0 || desc.a_idx >= 0) {
+				matched++;
+			}
+			if ((desc.flags & (DUK_PROPDESC_FLAGS_WEC | DUK_PROPDESC_FLAG_ACCESSOR)) ==
+			    (flags & (DUK_PROPDESC_FLAGS_WEC | DUK_PROPDESC_FLAG_ACCESSOR))) {
+				if (accessor) {
+					same = desc.get == duk_get_hobject(thr, -3) && desc.set == duk_get_hobject(thr, -2);
+				} else {
+					same = duk_samevalue(thr, -1, -2);
+				}
+			}
+			duk_pop_unsafe(thr);
+		} else {
+			matched++; /* defined below as a real property */
+		}
+
+		if (same) {
+			duk_pop_n(thr, accessor ? 3 : 2);
+		} else if (accessor) {
+			duk_def_prop(thr,
+			             obj_idx,
+			             DUK_DEFPROP_FORCE | DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER |
+			                 DUK_DEFPROP_HAVE_ENUMERABLE | DUK_DEFPROP_HAVE_CONFIGURABLE |
+			                 (flags & (DUK_DEFPROP_ENUMERABLE | DUK_DEFPROP_CONFIGURABLE)));
+		} else {
+			duk_def_prop(thr,
+			             obj_idx,
+			             DUK_DEFPROP_FORCE | DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_HAVE_WEC | (flags & DUK_DEFPROP_WEC));
+		}
+	}
+
+	for (i = 0; i < (duk_size_t) DUK_HOBJECT_GET_ENEXT(obj); i++) {
+		if (DUK_HOBJECT_E_GET_KEY(thr->heap, obj, i) != NULL) {
+			count++;
+		}
+	}
+	for (i = 0; i < (duk_size_t) DUK_HOBJECT_GET_ASIZE(obj); i++) {
+		if (!DUK_TVAL_IS_UNUSED(DUK_HOBJECT_A_GET_VALUE_PTR(thr->heap, obj, i))) {
+			count++;
+		}
+	}
+
+	return count > matched ? count - matched : 0;
+}
+
+/*
+ *  Harbour binding: deletes the own property named by the key on top of the
+ *  stack even if it is not configurable, e.g. a global 'var' binding.  Pops
+ *  the key; returns 1 if the property is gone.
+ */
+
+DUK_EXTERNAL duk_bool_t duk_hb_del_prop_force(duk_hthread *thr, duk_idx_t obj_idx) {
+	duk_hobject *obj;
+	duk_hstring *key;
+	duk_bool_t rc;
+
+	DUK_ASSERT_API_ENTRY(thr);
+
+	obj = duk_require_hobject(thr, obj_idx);
+	key = duk_to_property_key_hstring(thr, -1);
+	rc = duk_hobject_delprop_raw(thr, obj, key, DUK_DELPROP_FLAG_FORCE);
+	duk_pop_unsafe(thr);
+	return rc;
+}
+
 /* automatic undefs */
 #undef DUK__ASSERT_LEFT
 #undef DUK__BYTECODE_INITIAL_ALLOC
@@ -17626,6 +17794,44 @@ DUK_EXTERNAL void duk_get_memory_functions(duk_hthread *thr, duk_memory_function
 	out_funcs->udata = heap->heap_udata;
 }
 
+#if defined(DUK_USE_HB_GC_STATS)
+DUK_LOCAL void duk__hb_count_heaphdr_list(duk_heap *heap, duk_heaphdr *curr, duk_hb_gc_stats *out_stats) {
+	DUK_UNREF(heap);  /* only used with pointer compression */
+	while (curr != NULL) {
+		if (DUK_HEAPHDR_GET_TYPE(curr) == DUK_HTYPE_BUFFER) {
+			out_stats->count_buffer++;
+		} else {
+			out_stats->count_object++;
+		}
+		curr = DUK_HEAPHDR_GET_NEXT(heap, curr);
+	}
+}
+
+DUK_EXTERNAL void duk_hb_get_gc_stats(duk_hthread *thr, duk_hb_gc_stats *out_stats) {
+	duk_heap *heap;
+
+	DUK_ASSERT_API_ENTRY(thr);
+	DUK_ASSERT(out_stats != NULL);
+
+	heap = thr->heap;
+	out_stats->ms_count = heap->hb_ms_count;
+	out_stats->ms_time_total = heap->hb_ms_time_total;
+	out_stats->ms_time_max = heap->hb_ms_time_max;
+	out_stats->refzero_free_count = heap->hb_refzero_free_count;
+	out_stats->count_object = 0;
+	out_stats->count_buffer = 0;
+	duk__hb_count_heaphdr_list(heap, heap->heap_allocated, out_stats);
+#if defined(DUK_USE_FINALIZER_SUPPORT)
+	duk__hb_count_heaphdr_list(heap, heap->finalize_list, out_stats);
+#endif
+#if (DUK_USE_STRTAB_MINSIZE != DUK_USE_STRTAB_MAXSIZE)
+	out_stats->count_string = (duk_size_t) heap->st_count;
+#else
+	out_stats->count_string = 0;
+#endif
+}
+#endif /* DUK_USE_HB_GC_STATS */
+
 DUK_EXTERNAL void duk_gc(duk_hthread *thr, duk_uint_t flags) {
 	duk_heap *heap;
 	duk_small_uint_t ms_flags;
@@ -44948,6 +45154,9 @@ DUK_INTERNAL duk_bool_t duk_fb_is_full(duk_fixedbuffer *fb) {
 /* maximum recursion depth for loop detection stacks */
 #define DUK__LOOP_STACK_DEPTH 256
 
+#endif /* DUK_USE_DEBUG */
+
+#if defined(DUK_USE_DEBUG) || defined(DUK_USE_HB_OPCODE_STATS)
 /* must match bytecode defines now; build autogenerate? */
 DUK_LOCAL const char * const duk__bc_optab[256] = {
 	"LDREG",       "STREG",       "JUMP",        "LDCONST",     "LDINT",       "LDINTX",      "LDTHIS",      "LDUNDEF",
@@ -44990,6 +45199,9 @@ DUK_LOCAL const char * const duk__bc_optab[256] = {
 	"UNUSED240",   "UNUSED241",   "UNUSED242",   "UNUSED243",   "UNUSED244",   "UNUSED245",   "UNUSED246",   "UNUSED247",
 	"UNUSED248",   "UNUSED249",   "UNUSED250",   "UNUSED251",   "UNUSED252",   "UNUSED253",   "UNUSED254",   "UNUSED255"
 };
+#endif /* DUK_USE_DEBUG || DUK_USE_HB_OPCODE_STATS */
+
+#if defined(DUK_USE_DEBUG)
 
 typedef struct duk__dprint_state duk__dprint_state;
 struct duk__dprint_state {
@@ -50287,6 +50499,9 @@ DUK_INTERNAL void duk_free_hobject(duk_heap *heap, duk_hobject *h) {
 		duk_hcompfunc *f = (duk_hcompfunc *) h;
 		DUK_UNREF(f);
 		/* Currently nothing to free; 'data' is a heap object */
+#if defined(DUK_USE_HB_OPCODE_STATS)
+		heap->hb_inst_collected += f->hb_inst_count;
+#endif
 	} else if (DUK_HOBJECT_IS_NATFUNC(h)) {
 		duk_hnatfunc *f = (duk_hnatfunc *) h;
 		DUK_UNREF(f);
@@ -50342,6 +50557,14 @@ DUK_INTERNAL void duk_free_hbuffer(duk_heap *heap, duk_hbuffer *h) {
 		DUK_DDD(DUK_DDDPRINT("free dynamic buffer %p", (void *) DUK_HBUFFER_DYNAMIC_GET_DATA_PTR(heap, g)));
 		DUK_FREE(heap, DUK_HBUFFER_DYNAMIC_GET_DATA_PTR(heap, g));
 	}
+#if defined(DUK_USE_HB_EXTBUF_FREE)
+	else if (DUK_HBUFFER_HAS_EXTERNAL(h)) {
+		void *ext = DUK_HBUFFER_EXTERNAL_GET_DATA_PTR(heap, (duk_hbuffer_external *) h);
+		if (ext != NULL) {
+			DUK_USE_HB_EXTBUF_FREE(heap->heap_udata, (const void *) ext);
+		}
+	}
+#endif
 	DUK_FREE(heap, (void *) h);
 }
 
@@ -53278,6 +53501,10 @@ DUK_INTERNAL void duk_heap_mark_and_sweep(duk_heap *heap, duk_small_uint_t flags
 	duk_size_t tmp;
 #endif
 	duk_bool_t entry_creating_error;
+#if defined(DUK_USE_HB_GC_STATS)
+	duk_double_t hb_time_start;
+	duk_double_t hb_time_used;
+#endif
 
 	DUK_STATS_INC(heap, stats_ms_try_count);
 #if defined(DUK_USE_DEBUG)
@@ -53310,6 +53537,10 @@ DUK_INTERNAL void duk_heap_mark_and_sweep(duk_heap *heap, duk_small_uint_t flags
 	DUK_ASSERT(heap->heap_thread != NULL);
 	DUK_ASSERT(heap->heap_thread->valstack != NULL);
 
+#if defined(DUK_USE_HB_GC_STATS)
+	hb_time_start = duk_time_get_monotonic_time(heap->heap_thread);
+#endif
+
 	DUK_D(DUK_DPRINT("garbage collect (mark-and-sweep) starting, requested flags: 0x%08lx, effective flags: 0x%08lx",
 	                 (unsigned long) flags,
 	                 (unsigned long) (flags | heap->ms_base_flags)));
@@ -53524,6 +53755,15 @@ DUK_INTERNAL void duk_heap_mark_and_sweep(duk_heap *heap, duk_small_uint_t flags
 	 *  Stats dump
 	 */
 
+#if defined(DUK_USE_HB_GC_STATS)
+	/* Pause excludes finalizer execution below, which runs user code. */
+	hb_time_used = duk_time_get_monotonic_time(heap->heap_thread) - hb_time_start;
+	heap->hb_ms_count++;
+	heap->hb_ms_time_total += hb_time_used;
+	if (hb_time_used > heap->hb_ms_time_max) {
+		heap->hb_ms_time_max = hb_time_used;
+	}
+#endif
 #if defined(DUK_USE_DEBUG)
 	duk__dump_stats(heap);
 #endif
@@ -54482,6 +54722,9 @@ DUK_LOCAL void duk__refcount_free_pending(duk_heap *heap) {
 		/* prev->next is intentionally not updated and is garbage. */
 
 		duk_free_hobject(heap, (duk_hobject *) curr); /* Invalidates 'curr'. */
+#if defined(DUK_USE_HB_GC_STATS)
+		heap->hb_refzero_free_count++;
+#endif
 
 		curr = prev;
 	} while (curr != NULL);
@@ -54632,6 +54875,9 @@ DUK_LOCAL DUK_INLINE void duk__refcount_refzero_hstring(duk_heap *heap, duk_hstr
 	duk_heap_strcache_string_remove(heap, str);
 	duk_heap_strtable_unlink(heap, str);
 	duk_free_hstring(heap, str);
+#if defined(DUK_USE_HB_GC_STATS)
+	heap->hb_refzero_free_count++;
+#endif
 }
 
 /*
@@ -54646,6 +54892,9 @@ DUK_LOCAL DUK_INLINE void duk__refcount_refzero_hbuffer(duk_heap *heap, duk_hbuf
 
 	DUK_HEAP_REMOVE_FROM_HEAP_ALLOCATED(heap, (duk_heaphdr *) buf);
 	duk_free_hbuffer(heap, buf);
+#if defined(DUK_USE_HB_GC_STATS)
+	heap->hb_refzero_free_count++;
+#endif
 }
 
 /*
@@ -57905,6 +58154,209 @@ DUK_INTERNAL duk_uint_fast32_t duk_hobject_pc2line_query(duk_hthread *thr, duk_i
 }
 
 #endif /* DUK_USE_PC2LINE */
+
+#if defined(DUK_USE_HB_EXEC_SAMPLE) || defined(DUK_USE_HB_OPCODE_STATS)
+/*
+ *  Harbour binding: function labels for the profiler and the opcode
+ *  statistics, "name (file:line)".  Reads own properties directly without
+ *  touching the value stack or allocating, so it is safe to call from the
+ *  executor interrupt.
+ */
+
+DUK_LOCAL char *duk__hb_label_append(char *p, char *end, const duk_uint8_t *data, duk_size_t len) {
+	while (len > 0 && p < end) {
+		duk_uint8_t ch = *data++;
+		/* ';' separates frames and newlines separate stacks. */
+		*p++ = (ch == (duk_uint8_t) ';' || ch == (duk_uint8_t) '\n' || ch == (duk_uint8_t) '\r') ? '_' : (char) ch;
+		len--;
+	}
+	return p;
+}
+
+DUK_LOCAL char *duk__hb_label_cstring(char *p, char *end, const char *str) {
+	return duk__hb_label_append(p, end, (const duk_uint8_t *) str, (duk_size_t) DUK_STRLEN(str));
+}
+
+DUK_LOCAL duk_hstring *duk__hb_label_strprop(duk_heap *heap, duk_hobject *obj, duk_small_uint_t stridx) {
+	duk_tval *tv;
+
+	tv = duk_hobject_find_entry_tval_ptr_stridx(heap, obj, stridx);
+	if (tv != NULL && DUK_TVAL_IS_STRING(tv)) {
+		return DUK_TVAL_GET_STRING(tv);
+	}
+	return NULL;
+}
+
+/* Label for 'func' (NULL for a lightfunc); 'pc' selects the line. */
+DUK_LOCAL char *duk__hb_label_func(duk_hthread *thr, char *p, char *end, duk_hobject *func, duk_uint_fast32_t pc) {
+	duk_hstring *h;
+	char tmp[32];
+
+	if (func == NULL) {
+		return duk__hb_label_cstring(p, end, "(lightfunc)");
+	}
+
+	h = duk__hb_label_strprop(thr->heap, func, DUK_STRIDX_NAME);
+	if (h != NULL && DUK_HSTRING_GET_BYTELEN(h) > 0) {
+		p = duk__hb_label_append(p, end, DUK_HSTRING_GET_DATA(h), DUK_HSTRING_GET_BYTELEN(h));
+	} else {
+		p = duk__hb_label_cstring(p, end, DUK_HOBJECT_IS_COMPFUNC(func) ? "(anon)" : "(native)");
+	}
+	if (DUK_HOBJECT_IS_COMPFUNC(func)) {
+		duk_uint_fast32_t line = 0;
+#if defined(DUK_USE_PC2LINE)
+		duk_tval *tv;
+
+		tv = duk_hobject_find_entry_tval_ptr_stridx(thr->heap, func, DUK_STRIDX_INT_PC2LINE);
+		if (tv != NULL && DUK_TVAL_IS_BUFFER(tv)) {
+			line = duk__hobject_pc2line_query_raw(thr, (duk_hbuffer_fixed *) (void *) DUK_TVAL_GET_BUFFER(tv), pc);
+		}
+#else
+		DUK_UNREF(pc);
+#endif
+		p = duk__hb_label_cstring(p, end, " (");
+		h = duk__hb_label_strprop(thr->heap, func, DUK_STRIDX_FILE_NAME);
+		if (h != NULL) {
+			p = duk__hb_label_append(p, end, DUK_HSTRING_GET_DATA(h), DUK_HSTRING_GET_BYTELEN(h));
+		}
+		DUK_SNPRINTF(tmp, sizeof(tmp), ":%lu)", (unsigned long) line);
+		tmp[sizeof(tmp) - 1] = (char) 0;
+		p = duk__hb_label_cstring(p, end, tmp);
+	}
+	return p;
+}
+#endif /* DUK_USE_HB_EXEC_SAMPLE || DUK_USE_HB_OPCODE_STATS */
+
+#if defined(DUK_USE_HB_EXEC_SAMPLE)
+/*
+ *  Harbour binding: call stack sampling for the profiler.  Writes the
+ *  current thread's activations, outermost first, as one collapsed stack
+ *  line ("outer (file:line);inner (file:line)").
+ */
+
+#define DUK__HB_SAMPLE_MAXDEPTH 64
+
+DUK_EXTERNAL duk_size_t duk_hb_sample_callstack(duk_hthread *thr, char *buf, duk_size_t size) {
+	duk_activation *acts[DUK__HB_SAMPLE_MAXDEPTH];
+	duk_activation *act;
+	duk_int_t n = 0;
+	duk_int_t i;
+	char *p = buf;
+	char *end = buf + size;
+
+	DUK_ASSERT_API_ENTRY(thr);
+	DUK_ASSERT(buf != NULL);
+
+	for (act = thr->callstack_curr; act != NULL; act = act->parent) {
+		if (n >= DUK__HB_SAMPLE_MAXDEPTH) {
+			/* Keep the innermost frames, they are where the time goes. */
+			p = duk__hb_label_cstring(p, end, "(truncated)");
+			if (p < end) {
+				*p++ = ';';
+			}
+			break;
+		}
+		acts[n++] = act;
+	}
+
+	for (i = n - 1; i >= 0; i--) {
+		p = duk__hb_label_func(thr, p, end, DUK_ACT_GET_FUNC(acts[i]), duk_hthread_get_act_prev_pc(thr, acts[i]));
+		if (i > 0 && p < end) {
+			*p++ = ';';
+		}
+	}
+
+	return (duk_size_t) (p - buf);
+}
+#endif /* DUK_USE_HB_EXEC_SAMPLE */
+
+#if defined(DUK_USE_HB_OPCODE_STATS)
+/*
+ *  Harbour binding: executed instruction counts, see the executor dispatch
+ *  loop.  Pushes { opcodes: { NAME: n }, functions: { label: n },
+ *  collected: n } where functions with the same label (closures created
+ *  from one function template) are summed and 'collected' holds the
+ *  counts of functions already freed.
+ */
+
+DUK_LOCAL duk_bool_t duk__hb_is_counted_func(duk_heaphdr *h) {
+	return DUK_HEAPHDR_GET_TYPE(h) == DUK_HTYPE_OBJECT && DUK_HOBJECT_IS_COMPFUNC((duk_hobject *) h) &&
+	       ((duk_hcompfunc *) h)->hb_inst_count != 0;
+}
+
+DUK_EXTERNAL void duk_hb_push_exec_stats(duk_hthread *thr, duk_bool_t reset) {
+	duk_heap *heap;
+	duk_heaphdr *curr;
+	duk_small_uint_t op;
+	duk_size_t n;
+	duk_idx_t base;
+	duk_idx_t i;
+	char buf[256];
+	char *p;
+
+	DUK_ASSERT_API_ENTRY(thr);
+
+	heap = thr->heap;
+	duk_push_object(thr);
+
+	duk_push_object(thr);
+	for (op = 0; op < 256; op++) {
+		if (heap->hb_op_count[op] != 0) {
+			duk_push_number(thr, (duk_double_t) heap->hb_op_count[op]);
+			duk_put_prop_string(thr, -2, duk__bc_optab[op]);
+		}
+		if (reset) {
+			heap->hb_op_count[op] = 0;
+		}
+	}
+	duk_put_prop_literal(thr, -2, "opcodes");
+
+	/* Pin the counted functions on the value stack first: the label and
+	 * property pushes below may throw or run a GC, so nothing may be held
+	 * only by a raw heap_allocated pointer (or by a raised ms_prevent_count)
+	 * while they run.  The second walk allocates nothing, so the list
+	 * cannot change under it.
+	 */
+	duk_push_object(thr);
+	n = 0;
+	for (curr = heap->heap_allocated; curr != NULL; curr = DUK_HEAPHDR_GET_NEXT(heap, curr)) {
+		if (duk__hb_is_counted_func(curr)) {
+			n++;
+		}
+	}
+	duk_require_stack(thr, (duk_idx_t) n);
+	base = duk_get_top(thr);
+	for (curr = heap->heap_allocated; curr != NULL && n > 0; curr = DUK_HEAPHDR_GET_NEXT(heap, curr)) {
+		if (duk__hb_is_counted_func(curr)) {
+			duk_push_hobject(thr, (duk_hobject *) curr);
+			n--;
+		}
+	}
+
+	for (i = base; i < duk_get_top(thr); i++) {
+		duk_hcompfunc *f = (duk_hcompfunc *) duk_known_hobject(thr, i);
+
+		p = duk__hb_label_func(thr, buf, buf + sizeof(buf), (duk_hobject *) f, 0);
+		duk_push_lstring(thr, buf, (duk_size_t) (p - buf));
+		duk_dup_top(thr);
+		duk_get_prop(thr, base - 1);
+		duk_push_number(thr, duk_get_number_default(thr, -1, 0.0) + (duk_double_t) f->hb_inst_count);
+		duk_remove(thr, -2);
+		duk_put_prop(thr, base - 1);
+		if (reset) {
+			f->hb_inst_count = 0;
+		}
+	}
+	duk_set_top(thr, base);
+	duk_put_prop_literal(thr, -2, "functions");
+
+	duk_push_number(thr, (duk_double_t) heap->hb_inst_collected);
+	duk_put_prop_literal(thr, -2, "collected");
+	if (reset) {
+		heap->hb_inst_collected = 0;
+	}
+}
+#endif /* DUK_USE_HB_OPCODE_STATS */
 /*
  *  duk_hobject property access functionality.
  *
@@ -79242,6 +79694,26 @@ DUK_LOCAL DUK_EXEC_NOINLINE_PERF DUK_COLD duk_small_uint_t duk__executor_interru
 	thr->interrupt_counter = ctr - 1;
 	DUK_HEAP_CLEAR_INTERRUPT_RUNNING(thr->heap);
 
+#if defined(DUK_USE_HB_EXEC_SAMPLE)
+	/* Harbour binding: sampling profiler, see duk_hb_sample_callstack().
+	 * Sampled before a possible task switch so the stack is the one that
+	 * used up the interrupt quantum.
+	 */
+	DUK_USE_HB_EXEC_SAMPLE(thr->heap->heap_udata, (void *) thr);
+#endif
+
+#if defined(DUK_USE_HB_EXEC_YIELD)
+	/* Harbour binding: the binding may park this execution here and switch
+	 * to another cooperative task (duk_suspend() plus a native stack switch,
+	 * duk_resume() on return).  This is a clean instruction boundary with
+	 * curr_pc already synced, and the interrupt state is reinitialized.
+	 * Not done while finalizers or error creation are in progress.
+	 */
+	if (thr->heap->pf_prevent_count == 0 && thr->heap->creating_error == 0) {
+		DUK_USE_HB_EXEC_YIELD(thr->heap->heap_udata, (void *) thr);
+	}
+#endif
+
 	return retval;
 }
 #endif /* DUK_USE_INTERRUPT_COUNTER */
@@ -80475,6 +80947,10 @@ restart_execution:
 
 		ins = *curr_pc++;
 		DUK_STATS_INC(thr->heap, stats_exec_opcodes);
+#if defined(DUK_USE_HB_OPCODE_STATS)
+		thr->heap->hb_op_count[DUK_DEC_OP(ins)]++;
+		DUK__FUN()->hb_inst_count++;
+#endif
 
 		/* Typing: use duk_small_(u)int_fast_t when decoding small
 		 * opcode fields (op, A, B, C, BC) which fit into 16 bits
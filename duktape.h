@@ -274,6 +274,19 @@ struct duk_memory_functions {
 	void *udata;
 };
 
+#if defined(DUK_USE_HB_GC_STATS)
+/* Harbour binding: garbage collection statistics. */
+typedef struct duk_hb_gc_stats {
+	duk_uint_t ms_count;          /* completed mark-and-sweep rounds */
+	duk_double_t ms_time_total;   /* cumulative mark-and-sweep pause (ms) */
+	duk_double_t ms_time_max;     /* longest single pause (ms) */
+	duk_size_t refzero_free_count;
+	duk_size_t count_object;      /* live population */
+	duk_size_t count_string;
+	duk_size_t count_buffer;
+} duk_hb_gc_stats;
+#endif
+
 struct duk_function_list_entry {
 	const char *key;
 	duk_c_function value;
@@ -531,6 +544,15 @@ DUK_EXTERNAL_DECL void duk_free(duk_context *ctx, void *ptr);
 DUK_EXTERNAL_DECL void *duk_realloc(duk_context *ctx, void *ptr, duk_size_t size);
 DUK_EXTERNAL_DECL void duk_get_memory_functions(duk_context *ctx, duk_memory_functions *out_funcs);
 DUK_EXTERNAL_DECL void duk_gc(duk_context *ctx, duk_uint_t flags);
+#if defined(DUK_USE_HB_GC_STATS)
+DUK_EXTERNAL_DECL void duk_hb_get_gc_stats(duk_context *ctx, duk_hb_gc_stats *out_stats);
+#endif
+#if defined(DUK_USE_HB_EXEC_SAMPLE)
+DUK_EXTERNAL_DECL duk_size_t duk_hb_sample_callstack(duk_context *ctx, char *buf, duk_size_t size);
+#endif
+#if defined(DUK_USE_HB_OPCODE_STATS)
+DUK_EXTERNAL_DECL void duk_hb_push_exec_stats(duk_context *ctx, duk_bool_t reset);
+#endif
 
 /*
  *  Error handling
@@ -1319,6 +1341,13 @@ DUK_EXTERNAL_DECL duk_int_t duk_compile_raw(duk_context *ctx, const char *src_bu
 DUK_EXTERNAL_DECL void duk_dump_function(duk_context *ctx);
 DUK_EXTERNAL_DECL void duk_load_function(duk_context *ctx);
 
+/* Harbour binding: environment records a dump/load round trip would drop */
+DUK_EXTERNAL_DECL duk_idx_t duk_hb_push_scope_records(duk_context *ctx, duk_idx_t idx);
+
+/* Harbour binding: property restore for DUK_RESET checkpoints */
+DUK_EXTERNAL_DECL duk_size_t duk_hb_restore_props(duk_context *ctx, duk_idx_t obj_idx, duk_idx_t rec_idx);
+DUK_EXTERNAL_DECL duk_bool_t duk_hb_del_prop_force(duk_context *ctx, duk_idx_t obj_idx);
+
 /*
  *  Debugging
  */
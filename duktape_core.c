@@ -1,193 +1,6328 @@
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#define _HB_API_INTERNAL_                /* DUK_PUSH_BUFFER_VIEW 需判斷字串緩衝區是否為靜態 */
 #include "hbapi.h"
 #include "hbapiitm.h"
 #include "hbapierr.h"
 #include "hbvm.h"
 #include "hbstack.h"
+#include "hbthread.h"
 #include "duktape.h"
 
-/* 全局 Duktape 上下文 */
-static duk_context *ctx = NULL;
+/* 逾時, 任務讓出, 取樣和外部緩衝區的鉤子在 duk_config.h 中以 HB_DUK_BINDING 開啟,
+ * duktape.c 與本文件須以相同設定編譯 (見 duktape.hbp) */
+#if !defined(HB_DUK_BINDING)
+   #error "duktape_core.c requires -DHB_DUK_BINDING"
+#endif
+
+#if defined(HB_OS_WIN)
+   #include <windows.h>
+#elif defined(HB_OS_UNIX)
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/mman.h>
+   #if !defined(HB_OS_DARWIN)
+      #include <ucontext.h>
+   #endif
+#endif
+
+/* 協作式任務 (DUK_TASK_*) 需要切換 C 堆疊: Windows 使用 fiber, 其他 Unix 使用 ucontext */
+#if defined(HB_OS_WIN) || (defined(HB_OS_UNIX) && !defined(HB_OS_DARWIN))
+   #define HB_DUK_TASKS
+#endif
+
+/* DUK_EVAL 編譯快取 (以源碼雜湊為鍵的 LRU) */
+#define HB_DUK_EVAL_CACHE_DEFAULT  256
+
+typedef struct
+{
+   HB_U32   hash;
+   HB_SIZE  len;
+   char    *source;
+   int      prev;       /* LRU 鏈結, -1 表示結尾 */
+   int      next;
+   int      chain;      /* 雜湊桶鏈結 */
+} HB_DUK_CACHE_ENTRY;
+
+typedef struct
+{
+   HB_DUK_CACHE_ENTRY *entries;
+   int     *buckets;
+   int      capacity;
+   int      mask;
+   int      count;
+   int      head;       /* 最近使用 */
+   int      tail;       /* 最久未使用 */
+   void    *store;      /* heap stash 中保存已編譯函數的陣列 */
+   HB_MAXUINT hits;
+   HB_MAXUINT misses;
+} HB_DUK_CACHE;
+
+/* 按大小分級的 slab 分配器: 小塊從每個 heap 自己的空閒表取得,
+ * 大塊直接交給 hb_xalloc; 每塊前置標頭記錄請求大小 */
+#define HB_DUK_SLAB_GRAIN    16
+#define HB_DUK_SLAB_CLASSES  32       /* 16 .. 512 位元組 (含標頭) */
+#define HB_DUK_SLAB_MAX      (HB_DUK_SLAB_GRAIN * HB_DUK_SLAB_CLASSES)
+#ifndef HB_DUK_SLAB_SIZE
+#define HB_DUK_SLAB_SIZE     16384
+#endif
+
+typedef union
+{
+   duk_size_t size;
+   double     align_d;   /* 保證負載按 8 位元組對齊 (DUK_USE_ALIGN_BY) */
+   void      *align_p;
+} HB_DUK_BLOCK;
+
+typedef struct
+{
+   void *pFree[HB_DUK_SLAB_CLASSES];   /* 各級空閒塊鏈表 */
+   void *pSlabs;                       /* 已配置 slab 鏈表, 銷毀 heap 時整批釋放 */
+   HB_SIZE nSlabs;
+} HB_DUK_SLAB;
+
+/* setTimeout/setInterval 的排程項目, 回調存放在 heap stash 以 nId 索引 */
+typedef struct
+{
+   HB_MAXUINT    nDue;         /* 到期時間 (單調時鐘微秒) */
+   HB_MAXUINT    nSeq;         /* 同時到期時依建立順序執行 */
+   HB_MAXINT     nInterval;    /* 重複間隔 (毫秒), -1 為單次 */
+   duk_uarridx_t nId;
+   struct _HB_DUK_REALM *pRealm;   /* 建立時正在執行的 realm, 回調在其預算內執行 */
+} HB_DUK_TIMER;
+
+/* 延遲直方圖 (DUK_LATENCY_ENABLE): HDR 式對數線性分格, 64 微秒以下逐一計數,
+ * 之上每個 2 的冪次區間再分 32 格, 相對誤差約 3% */
+#define HB_DUK_LAT_SUB      32
+#define HB_DUK_LAT_BUCKETS  (2 * HB_DUK_LAT_SUB + 58 * HB_DUK_LAT_SUB)
+#define HB_DUK_LAT_TABLE    256     /* 名稱雜湊表的鏈數 */
+#define HB_DUK_LAT_MAX      1024    /* 名稱數上限, 超出的記入 "(other)" */
+#define HB_DUK_LAT_KEY      256
+
+typedef struct _HB_DUK_LAT
+{
+   struct _HB_DUK_LAT *pNext;
+   HB_U32      nHash;
+   HB_MAXUINT  nCount;
+   HB_MAXUINT  nSum;           /* 微秒 */
+   HB_MAXUINT  nMin;
+   HB_MAXUINT  nMax;
+   HB_MAXUINT  nBuckets[HB_DUK_LAT_BUCKETS];
+   HB_SIZE     nLen;
+   char        szName[1];      /* 變長, 如 "eval:1a2b3c4d", "call:name", "callback:name" */
+} HB_DUK_LAT;
+
+/* 每個 Duktape heap 的狀態, 以引用計數管理 (hb_xRefInc/hb_xRefDec) */
+#define HB_DUK_MAX_CALLBACKS  32767   /* 槽位編號存放在 16 位元的 magic 中 */
+
+typedef struct _HB_DUK
+{
+   duk_context  *ctx;          /* 執行用的 context, DUK_RESET 後為新全局環境的執行緒 */
+   duk_context  *heap;         /* duk_create_heap 返回的初始執行緒, 銷毀 heap 時使用 */
+   HB_DUK_CACHE  cache;
+   HB_DUK_SLAB   slab;
+   duk_size_t    nMemLive;     /* 目前配置給 Duktape 的位元組數 */
+   duk_size_t    nMemLimit;    /* DUK_SET_MEMORY_LIMIT 設定的上限, 0 為不限 */
+   duk_size_t    nMemPeak;
+   HB_MAXUINT    nAllocs;      /* 分配器統計 (DUK_GET_ALLOC_STATS) */
+   HB_MAXUINT    nFrees;
+   HB_MAXUINT    nReallocs;
+   HB_MAXUINT    nAllocFails;
+   HB_MAXUINT    nDeadline;    /* 執行截止時間 (單調時鐘微秒), 0 為不限 */
+   HB_MAXINT     nTimeout;     /* DUK_SET_TIMEOUT 設定的預設逾時 (毫秒) */
+   int           iExecDepth;   /* 巢狀執行層數 */
+   volatile int  fCancel;      /* DUK_CANCEL 可由其他執行緒設定 */
+   PHB_ITEM     *pCallbacks;   /* DUK_REGISTER_FUNCTION 註冊的代碼塊 */
+   int           iCallbacks;
+   void         *pFuncStore;   /* 函數句柄釘選陣列 (heap stash) */
+   int          *pFuncFree;    /* 可重用槽位, [iFuncClean, iFuncFree) 尚待清除 */
+   int           iFuncFree;
+   int           iFuncClean;
+   int           iFuncSlots;
+   HB_SIZE       nExtMin;      /* 外部字串門檻 (DUK_EXTERNAL_STRINGS), 0 為停用 */
+   PHB_ITEM      pExtPending;  /* 正在推入的字串項目, 僅供 intern 檢查比對 */
+   PHB_ITEM     *pPinned;      /* 被 Duktape 直接引用而釘選的字串項目 (外部字串/緩衝區) */
+   int           iPinned;
+   int           iPinnedMax;
+   void         *pCheckpoint;  /* DUK_CHECKPOINT 的記錄 (heap stash), DUK_RESET 時據此還原 */
+   struct _HB_DUK_REALM *pRealm;   /* 正在執行的 realm, 記憶體用量記入其帳上 */
+   void         *pJobStore;    /* Promise 工作佇列 (heap stash), [nJobHead, nJobTail) 待執行 */
+   duk_uarridx_t nJobHead;
+   duk_uarridx_t nJobTail;
+   struct _HB_DUK_REALM **pJobRealm;   /* 各工作排入時正在執行的 realm, 以工作索引對應 */
+   duk_uarridx_t nJobRealmMax;
+   HB_DUK_TIMER *pTimers;      /* 計時器最小堆積 */
+   int           iTimers;
+   int           iTimerMax;
+   HB_MAXUINT    nTimerSeq;
+   duk_uarridx_t nTimerId;
+   void         *pTimerStore;  /* 計時器編號 -> [fn, 參數...] (heap stash) */
+   struct _HB_DUK_TASK *pTask; /* 正在執行的任務 (DUK_TASK_RUN) */
+   int           iCallDepth;   /* 進行中的 Harbour 回調層數 */
+   PHB_ITEM      pProfile;     /* 取樣分析器: 折疊堆疊 -> 樣本數, NULL 為未啟用 */
+   int           iProfileEvery;   /* 每幾次執行器中斷取樣一次 */
+   int           iProfileTick;
+   HB_DUK_LAT  **pLatency;     /* 各入口的延遲直方圖, NULL 為未啟用 */
+   int           iLatency;
+   char        **pCallbackNames;   /* 與 pCallbacks 對應的註冊名稱 */
+} HB_DUK, *PHB_DUK;
+
+/* Realm: 共用 heap (分配器, 字串表) 但擁有獨立全局對象的執行緒 (DUK_REALM_NEW) */
+#define HB_DUK_REALM_CACHE_DEFAULT  32
+
+typedef struct _HB_DUK_REALM
+{
+   PHB_DUK       pDuk;
+   duk_context  *ctx;
+   int           iSlot;        /* 執行緒在 heap stash 中的釘選槽位 */
+   HB_DUK_CACHE  cache;        /* 已編譯函數綁定各自的全局環境, 不能與 heap 共用 */
+   duk_size_t    nMemLimit;    /* 記憶體預算, 0 為不限 */
+   HB_MAXINT     nMemUsed;     /* 執行期間 heap 的淨增長累計 (近似值) */
+   duk_size_t    nMemMark;     /* 開始計帳時的 nMemLive */
+   HB_MAXINT     nTimeout;     /* 預設逾時 (毫秒), 0 使用 heap 設定 */
+} HB_DUK_REALM, *PHB_DUK_REALM;
+
+/* 任務: 在自己的 Duktape 執行緒及 C 堆疊上執行的腳本, 可在時間片用完或 taskYield() 時
+ * 暫停 (duk_suspend) 並返回調用者, 由 DUK_TASK_RUN 在同一個 OS 執行緒中恢復 */
+#define HB_DUK_TASK_READY      0
+#define HB_DUK_TASK_SUSPENDED  1
+#define HB_DUK_TASK_RUNNING    2
+#define HB_DUK_TASK_DONE       3
+#define HB_DUK_TASK_FAILED     4
+
+#define HB_DUK_TASK_STACK            (1024 * 1024)
+#define HB_DUK_TASK_QUANTUM_DEFAULT  10    /* 毫秒 */
+
+typedef struct _HB_DUK_TASK
+{
+   PHB_DUK           pDuk;
+   PHB_DUK_REALM     pRealm;     /* 持有 GC 引用 */
+   duk_context      *ctx;        /* 任務執行緒, 結束後堆疊頂端為結果或錯誤 */
+   int               iSlot;
+   int               iState;
+   HB_MAXINT         nTimeout;
+   HB_MAXUINT        nSliceEnd;  /* 本次時間片的結束時間 (單調時鐘微秒) */
+   HB_MAXUINT        nSlices;
+   HB_MAXUINT        nLeft;      /* 暫停時剩餘的逾時 (微秒), 0 為不限 */
+   duk_thread_state  state;      /* duk_suspend 保存的 heap 狀態 */
+#if defined(HB_OS_WIN)
+   LPVOID            fiber;
+   LPVOID            caller;
+#elif defined(HB_DUK_TASKS)
+   ucontext_t        uc;
+   ucontext_t        caller;
+   void             *stack;
+#endif
+} HB_DUK_TASK, *PHB_DUK_TASK;
+
+/* 未指定 heap 參數時使用的預設 heap (DUK_INIT), 不持有引用 */
+static PHB_DUK s_pDefault = NULL;
+
+static HB_U32 hb_duk_hash(const char *data, HB_SIZE len)
+{
+   HB_U32 hash = 2166136261U;   /* FNV-1a */
+
+   while (len--)
+   {
+      hash ^= (HB_UCHAR)*data++;
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+/* 64 位元 FNV-1a, 用於驗證位元組碼快取對應的源碼及快取內容本身 */
+static HB_U64 hb_duk_hash64(const char *data, HB_SIZE len)
+{
+   HB_U64 hash = 14695981039346656037ULL;
+
+   while (len--)
+   {
+      hash ^= (HB_UCHAR)*data++;
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+/* 釋放快取的 C 端資料; 已編譯函數隨 heap stash 一併回收 */
+static void hb_duk_cache_release(HB_DUK_CACHE *cache)
+{
+   int i;
+
+   if (cache->entries != NULL)
+   {
+      for (i = 0; i < cache->count; i++)
+      {
+         hb_xfree(cache->entries[i].source);
+      }
+      hb_xfree(cache->entries);
+      hb_xfree(cache->buckets);
+      cache->entries = NULL;
+      cache->buckets = NULL;
+   }
+   cache->count = 0;
+   cache->head = cache->tail = -1;
+   cache->store = NULL;
+}
+
+/* 清空快取並在 heap stash 中換上新的空陣列 */
+static void hb_duk_cache_reset(duk_context *c, HB_DUK_CACHE *cache)
+{
+   hb_duk_cache_release(cache);
+
+   if (c != NULL && cache->capacity > 0)
+   {
+      int size = 1;
+
+      while (size < cache->capacity * 2)
+      {
+         size <<= 1;
+      }
+      cache->entries = (HB_DUK_CACHE_ENTRY *)hb_xgrab(sizeof(HB_DUK_CACHE_ENTRY) * cache->capacity);
+      cache->buckets = (int *)hb_xgrab(sizeof(int) * size);
+      memset(cache->buckets, 0xFF, sizeof(int) * size);
+      cache->mask = size - 1;
+
+      /* 已編譯函數屬於 c 的全局環境, 快取陣列放在該環境的 global stash */
+      duk_push_global_stash(c);
+      duk_push_array(c);
+      cache->store = duk_get_heapptr(c, -1);
+      duk_put_prop_string(c, -2, "hbEvalCache");
+      duk_pop(c);
+   }
+}
+
+static void hb_duk_cache_unlink(HB_DUK_CACHE *cache, int i)
+{
+   HB_DUK_CACHE_ENTRY *e = &cache->entries[i];
+
+   if (e->prev >= 0)
+      cache->entries[e->prev].next = e->next;
+   else
+      cache->head = e->next;
+   if (e->next >= 0)
+      cache->entries[e->next].prev = e->prev;
+   else
+      cache->tail = e->prev;
+}
+
+static void hb_duk_cache_link_head(HB_DUK_CACHE *cache, int i)
+{
+   HB_DUK_CACHE_ENTRY *e = &cache->entries[i];
+
+   e->prev = -1;
+   e->next = cache->head;
+   if (cache->head >= 0)
+      cache->entries[cache->head].prev = i;
+   cache->head = i;
+   if (cache->tail < 0)
+      cache->tail = i;
+}
+
+/* 將堆疊頂端的已編譯函數存入快取陣列; 陣列增長需要配置記憶體, 可能拋出錯誤 */
+typedef struct
+{
+   void          *store;
+   duk_uarridx_t  idx;
+} HB_DUK_CACHE_PUT;
+
+static duk_ret_t hb_duk_cache_put_raw(duk_context *c, void *udata)
+{
+   HB_DUK_CACHE_PUT *put = (HB_DUK_CACHE_PUT *)udata;
+
+   duk_push_heapptr(c, put->store);
+   duk_dup(c, -2);
+   duk_put_prop_index(c, -2, put->idx);
+   return 0;
+}
+
+/* 編譯 (或從快取取得) 並執行 eval 代碼, 返回值與 duk_peval 相同 */
+static duk_int_t hb_duk_peval_cached(duk_context *c, HB_DUK_CACHE *cache, const char *code, HB_SIZE len)
+{
+   HB_DUK_CACHE_ENTRY *e;
+   HB_DUK_CACHE_PUT put;
+   HB_U32 hash;
+   int *pLink;
+   int i;
+   duk_int_t rc;
+
+   if (cache->capacity <= 0)
+   {
+      return duk_peval_lstring(c, code, len);
+   }
+   if (cache->entries == NULL)
+   {
+      hb_duk_cache_reset(c, cache);
+   }
+
+   hash = hb_duk_hash(code, len);
+   for (i = cache->buckets[hash & cache->mask]; i >= 0; i = cache->entries[i].chain)
+   {
+      e = &cache->entries[i];
+      if (e->hash == hash && e->len == len && memcmp(e->source, code, len) == 0)
+      {
+         break;
+      }
+   }
+
+   if (i >= 0)
+   {
+      cache->hits++;
+      if (cache->head != i)
+      {
+         hb_duk_cache_unlink(cache, i);
+         hb_duk_cache_link_head(cache, i);
+      }
+      duk_push_heapptr(c, cache->store);
+      duk_get_prop_index(c, -1, (duk_uarridx_t)i);
+      duk_remove(c, -2);
+   }
+   else
+   {
+      cache->misses++;
+      if (duk_pcompile_lstring(c, DUK_COMPILE_EVAL, code, len) != 0)
+      {
+         return DUK_EXEC_ERROR;
+      }
+
+      /* 先存入陣列, 成功後才更新鏈結; 存入失敗時不快取, 照常執行 */
+      i = cache->count < cache->capacity ? cache->count : cache->tail;
+      put.store = cache->store;
+      put.idx = (duk_uarridx_t)i;
+      rc = duk_safe_call(c, hb_duk_cache_put_raw, &put, 0, 1);
+      duk_pop(c);
+      if (rc == DUK_EXEC_SUCCESS)
+      {
+         if (i == cache->count)
+         {
+            cache->count++;
+         }
+         else
+         {
+            /* 淘汰最久未使用的項目, 其函數已被覆寫 */
+            e = &cache->entries[i];
+            hb_duk_cache_unlink(cache, i);
+            for (pLink = &cache->buckets[e->hash & cache->mask]; *pLink != i; pLink = &cache->entries[*pLink].chain)
+               ;
+            *pLink = e->chain;
+            hb_xfree(e->source);
+         }
+
+         e = &cache->entries[i];
+         e->hash = hash;
+         e->len = len;
+         e->source = (char *)hb_xgrab(len + 1);
+         memcpy(e->source, code, len);
+         e->chain = cache->buckets[hash & cache->mask];
+         cache->buckets[hash & cache->mask] = i;
+         hb_duk_cache_link_head(cache, i);
+      }
+   }
+
+   duk_push_global_object(c);   /* 與 duk_eval 相同的 'this' 綁定 */
+   return duk_pcall_method(c, 0);
+}
+
+/* 唯讀映射整個文件, 不支援 mmap 的平台退回讀入記憶體 */
+typedef struct
+{
+   const char *data;
+   HB_SIZE     len;
+#if defined(HB_OS_WIN)
+   HANDLE      hFile;
+   HANDLE      hMap;
+#elif defined(HB_OS_UNIX)
+   int         fd;
+#else
+   char       *buffer;
+#endif
+} HB_DUK_MAP;
+
+static HB_BOOL hb_duk_map_open(const char *filename, HB_DUK_MAP *map)
+{
+#if defined(HB_OS_WIN)
+   LARGE_INTEGER size;
+
+   memset(map, 0, sizeof(HB_DUK_MAP));
+   map->hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (map->hFile == INVALID_HANDLE_VALUE)
+   {
+      return HB_FALSE;
+   }
+   if (!GetFileSizeEx(map->hFile, &size))
+   {
+      CloseHandle(map->hFile);
+      return HB_FALSE;
+   }
+   map->len = (HB_SIZE)size.QuadPart;
+   if (map->len == 0)
+   {
+      map->data = "";
+      return HB_TRUE;
+   }
+   map->hMap = CreateFileMappingA(map->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (map->hMap != NULL)
+   {
+      map->data = (const char *)MapViewOfFile(map->hMap, FILE_MAP_READ, 0, 0, 0);
+   }
+   if (map->data == NULL)
+   {
+      if (map->hMap != NULL)
+      {
+         CloseHandle(map->hMap);
+      }
+      CloseHandle(map->hFile);
+      return HB_FALSE;
+   }
+   return HB_TRUE;
+#elif defined(HB_OS_UNIX)
+   struct stat st;
+   void *data;
+
+   memset(map, 0, sizeof(HB_DUK_MAP));
+   map->fd = open(filename, O_RDONLY);
+   if (map->fd < 0)
+   {
+      return HB_FALSE;
+   }
+   if (fstat(map->fd, &st) != 0)
+   {
+      close(map->fd);
+      return HB_FALSE;
+   }
+   map->len = (HB_SIZE)st.st_size;
+   if (map->len == 0)
+   {
+      map->data = "";
+      return HB_TRUE;
+   }
+   data = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, map->fd, 0);
+   if (data == MAP_FAILED)
+   {
+      close(map->fd);
+      return HB_FALSE;
+   }
+   map->data = (const char *)data;
+   return HB_TRUE;
+#else
+   FILE *fp;
+   long size;
+
+   memset(map, 0, sizeof(HB_DUK_MAP));
+   fp = fopen(filename, "rb");
+   if (fp == NULL)
+   {
+      return HB_FALSE;
+   }
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+   map->buffer = (char *)hb_xalloc(size + 1);
+   if (map->buffer == NULL || fread(map->buffer, 1, size, fp) != (size_t)size)
+   {
+      if (map->buffer != NULL)
+      {
+         hb_xfree(map->buffer);
+      }
+      fclose(fp);
+      return HB_FALSE;
+   }
+   fclose(fp);
+   map->data = map->buffer;
+   map->len = (HB_SIZE)size;
+   return HB_TRUE;
+#endif
+}
+
+static void hb_duk_map_close(HB_DUK_MAP *map)
+{
+#if defined(HB_OS_WIN)
+   if (map->hMap != NULL)
+   {
+      UnmapViewOfFile(map->data);
+      CloseHandle(map->hMap);
+   }
+   CloseHandle(map->hFile);
+#elif defined(HB_OS_UNIX)
+   if (map->len > 0)
+   {
+      munmap((void *)map->data, map->len);
+   }
+   close(map->fd);
+#else
+   hb_xfree(map->buffer);
+#endif
+   map->data = NULL;
+}
+
+/* DUK_EVAL_FILE 磁碟位元組碼快取 (源文件旁的 .dukbc 文件) */
+#define HB_DUK_BC_EXT    ".dukbc"
+#define HB_DUK_BC_MAGIC  "HBDUKBC3"
+#define HB_DUK_BC_STR_(x)  #x
+#define HB_DUK_BC_STR(x)   HB_DUK_BC_STR_(x)
+
+/* 影響位元組碼格式的建置設定, 其雜湊寫入 header; 設定不同的引擎不共用快取 */
+static const char s_szBcConfig[] = DUK_GIT_COMMIT " " HB_DUK_BC_STR(DUK_VERSION)
+#if defined(DUK_USE_BYTEORDER)
+   " byteorder=" HB_DUK_BC_STR(DUK_USE_BYTEORDER)
+#endif
+#if defined(DUK_USE_PACKED_TVAL)
+   " packed-tval"
+#endif
+#if defined(DUK_USE_FASTINT)
+   " fastint"
+#endif
+#if defined(DUK_USE_REGEXP_SUPPORT)
+   " regexp"
+#endif
+   ;
+
+typedef struct
+{
+   char    magic[8];
+   HB_U32  config;      /* s_szBcConfig 的雜湊 */
+   HB_U32  ptrsize;     /* 位元組碼僅適用於相同建置的引擎 */
+   HB_U64  srcsize;
+   HB_U64  srchash;     /* 源碼的 FNV-1a 雜湊; 修改時間只精確到秒, 不足以判斷源碼是否改變 */
+   HB_U64  length;      /* 之後的 duk_dump_function 資料長度 */
+   HB_U64  payhash;     /* 資料的雜湊; duk_load_function 不驗證輸入, 損壞的資料不能交給它 */
+} HB_DUK_BC_HEADER;
+
+static HB_BOOL s_fBytecodeCache = HB_FALSE;
+
+/* payhash 不在此填入: 載入時只比較它之前的欄位, 再驗證資料 */
+static void hb_duk_bc_header(HB_DUK_BC_HEADER *hdr, HB_SIZE srcsize, HB_U64 srchash, HB_SIZE length)
+{
+   memset(hdr, 0, sizeof(HB_DUK_BC_HEADER));
+   memcpy(hdr->magic, HB_DUK_BC_MAGIC, sizeof(hdr->magic));
+   hdr->config = hb_duk_hash(s_szBcConfig, sizeof(s_szBcConfig) - 1);
+   hdr->ptrsize = (HB_U32)sizeof(void *);
+   hdr->srcsize = (HB_U64)srcsize;
+   hdr->srchash = srchash;
+   hdr->length = (HB_U64)length;
+}
+
+static duk_ret_t hb_duk_bc_load_raw(duk_context *c, void *udata)
+{
+   (void)udata;  /* 避免未使用參數警告 */
+   duk_load_function(c);
+   return 1;
+}
+
+/* 從映射的快取文件載入已編譯函數, 成功時函數留在堆疊頂端 */
+static HB_BOOL hb_duk_bc_load(duk_context *c, const char *cachename, HB_SIZE srcsize, HB_U64 srchash)
+{
+   HB_DUK_BC_HEADER hdr;
+   HB_DUK_MAP map;
+   HB_BOOL fOK = HB_FALSE;
+
+   if (!hb_duk_map_open(cachename, &map))
+   {
+      return HB_FALSE;
+   }
+
+   hb_duk_bc_header(&hdr, srcsize, srchash, map.len >= sizeof(hdr) ? map.len - sizeof(hdr) : 0);
+   if (map.len > sizeof(hdr) && memcmp(map.data, &hdr, offsetof(HB_DUK_BC_HEADER, payhash)) == 0)
+   {
+      memcpy(&hdr.payhash, map.data + offsetof(HB_DUK_BC_HEADER, payhash), sizeof(hdr.payhash));
+   }
+   if (hdr.payhash != 0 && hdr.payhash == hb_duk_hash64(map.data + sizeof(hdr), (HB_SIZE)hdr.length))
+   {
+      /* 外部緩衝區直接指向映射內容, duk_load_function 不需解析源碼 */
+      duk_push_external_buffer(c);
+      duk_config_buffer(c, -1, (void *)(map.data + sizeof(hdr)), (duk_size_t)hdr.length);
+      if (duk_safe_call(c, hb_duk_bc_load_raw, NULL, 1, 1) == DUK_EXEC_SUCCESS)
+      {
+         fOK = HB_TRUE;
+      }
+      else
+      {
+         duk_pop(c);
+      }
+   }
+
+   hb_duk_map_close(&map);
+   return fOK;
+}
+
+/* 臨時文件名的序號, 同一進程的多個執行緒同時寫入同一文件時互不覆寫 */
+static HB_CRITICAL_NEW(s_tmpMtx);
+static unsigned long s_ulTmpSeq = 0;
+
+/* 寫入 header 與資料: 先寫臨時文件再改名, 避免其他進程讀到不完整的內容.
+ * 臨時文件名含進程編號和序號, 並行的寫入者各自寫自己的文件, 最後改名者勝出 */
+static HB_BOOL hb_duk_file_store(const char *filename, const void *hdr, HB_SIZE hdrlen, const void *data, HB_SIZE len)
+{
+   char *tmpname;
+   size_t namesize = strlen(filename) + 48;
+   unsigned long ulPid, ulSeq;
+   FILE *fp;
+   HB_BOOL fOK = HB_FALSE;
+
+#if defined(HB_OS_WIN)
+   ulPid = (unsigned long)GetCurrentProcessId();
+#elif defined(HB_OS_UNIX)
+   ulPid = (unsigned long)getpid();
+#else
+   ulPid = 0;
+#endif
+   hb_threadEnterCriticalSection(&s_tmpMtx);
+   ulSeq = s_ulTmpSeq++;
+   hb_threadLeaveCriticalSection(&s_tmpMtx);
+
+   tmpname = (char *)hb_xgrab(namesize);
+   hb_snprintf(tmpname, namesize, "%s.%lu.%lu.tmp", filename, ulPid, ulSeq);
+
+   fp = fopen(tmpname, "wb");
+   if (fp != NULL)
+   {
+      fOK = (hdrlen == 0 || fwrite(hdr, hdrlen, 1, fp) == 1) &&
+            (len == 0 || fwrite(data, len, 1, fp) == 1);
+      fOK = fclose(fp) == 0 && fOK;
+      if (fOK)
+      {
+#if defined(HB_OS_WIN)
+         /* Windows 的 rename 不覆寫已存在的文件; POSIX 的 rename 原子地取代, 讀者不會看到文件消失 */
+         remove(filename);
+#endif
+         fOK = rename(tmpname, filename) == 0;
+      }
+      if (!fOK)
+      {
+         remove(tmpname);
+      }
+   }
+
+   hb_xfree(tmpname);
+   return fOK;
+}
+
+/* 將堆疊頂端的已編譯函數寫入快取文件, 失敗時忽略 */
+static void hb_duk_bc_store(duk_context *c, const char *cachename, HB_SIZE srcsize, HB_U64 srchash)
+{
+   HB_DUK_BC_HEADER hdr;
+   duk_size_t len;
+   void *data;
+
+   duk_dup(c, -1);
+   duk_dump_function(c);
+   data = duk_get_buffer(c, -1, &len);
+
+   hb_duk_bc_header(&hdr, srcsize, srchash, (HB_SIZE)len);
+   hdr.payhash = hb_duk_hash64((const char *)data, (HB_SIZE)len);
+   hb_duk_file_store(cachename, &hdr, sizeof(hdr), data, (HB_SIZE)len);
+   duk_pop(c);
+}
+
+/* 釘選字串項目, 使其緩衝區在 Duktape 引用期間保持有效; 返回釘選的副本 */
+static PHB_ITEM hb_duk_pin_item(PHB_DUK pDuk, PHB_ITEM pItem)
+{
+   /* 複製項目只增加字串緩衝區引用計數, 原項目之後被修改也不影響 */
+   PHB_ITEM pPin = hb_itemNew(pItem);
+
+   if (pDuk->iPinned >= pDuk->iPinnedMax)
+   {
+      pDuk->iPinnedMax = pDuk->iPinnedMax > 0 ? pDuk->iPinnedMax * 2 : 16;
+      pDuk->pPinned = (PHB_ITEM *)hb_xrealloc(pDuk->pPinned, sizeof(PHB_ITEM) * pDuk->iPinnedMax);
+   }
+   pDuk->pPinned[pDuk->iPinned++] = pPin;
+   return pPin;
+}
+
+/* 依緩衝區位址解除釘選; 最近釘選的通常最先釋放, 故由尾端搜尋 */
+static void hb_duk_unpin_ptr(PHB_DUK pDuk, const void *ptr)
+{
+   int i;
+
+   for (i = pDuk->iPinned - 1; i >= 0; i--)
+   {
+      if (hb_itemGetCPtr(pDuk->pPinned[i]) == (const char *)ptr)
+      {
+         hb_itemRelease(pDuk->pPinned[i]);
+         pDuk->pPinned[i] = pDuk->pPinned[--pDuk->iPinned];
+         break;
+      }
+   }
+}
+
+/* Duktape 釋放外部緩衝區 (DUK_PUSH_BUFFER_VIEW) 時的回調 */
+void hb_duk_extbuf_free(void *udata, const void *ptr)
+{
+   hb_duk_unpin_ptr((PHB_DUK)udata, ptr);
+}
+
+#if defined(DUK_USE_HSTRING_EXTDATA)
+
+/* Duktape intern 新字串前的回調: 若正是待推入的 Harbour 字串且夠長,
+ * 釘選該項目並讓 Duktape 直接引用其緩衝區 (Harbour 字串必以 NUL 結尾) */
+void *hb_duk_extstr_intern_check(void *udata, void *ptr, duk_size_t len)
+{
+   PHB_DUK pDuk = (PHB_DUK)udata;
+   PHB_ITEM pItem = pDuk->pExtPending;
+
+   pDuk->pExtPending = NULL;
+   if (pItem == NULL || len < pDuk->nExtMin || hb_itemGetCPtr(pItem) != (const char *)ptr)
+   {
+      return NULL;
+   }
+
+   hb_duk_pin_item(pDuk, pItem);
+   return ptr;
+}
+
+/* Duktape 釋放外部字串時解除釘選 */
+void hb_duk_extstr_free(void *udata, const void *ptr)
+{
+   hb_duk_unpin_ptr((PHB_DUK)udata, ptr);
+}
+
+#endif
+
+/* 推入 Harbour 字串 (保留長度與內嵌 NUL), 啟用外部字串時長字串不複製 */
+static void hb_duk_push_string_item(duk_context *c, PHB_ITEM pItem)
+{
+   const char *str = hb_itemGetCPtr(pItem);
+   HB_SIZE len = hb_itemGetCLen(pItem);
+#if defined(DUK_USE_HSTRING_EXTDATA)
+   duk_memory_functions funcs;
+   PHB_DUK pDuk;
+
+   duk_get_memory_functions(c, &funcs);
+   pDuk = (PHB_DUK)funcs.udata;
+   if (pDuk->nExtMin > 0 && len >= pDuk->nExtMin)
+   {
+      pDuk->pExtPending = pItem;
+      duk_push_lstring(c, str, (duk_size_t)len);
+      pDuk->pExtPending = NULL;
+      return;
+   }
+#endif
+   duk_push_lstring(c, str, (duk_size_t)len);
+}
+
+/* 以長度返回堆疊上的值的字串形式, 內嵌 NUL 不會截斷 */
+static void hb_duk_retstr(duk_context *c, duk_idx_t idx)
+{
+   duk_size_t len;
+   const char *str = duk_safe_to_lstring(c, idx, &len);
+
+   hb_retclen(str, (HB_SIZE)len);
+}
+
+/* Harbour <-> JavaScript 值轉換 (遞迴, 不經 JSON); 共用的子陣列/對象轉換後仍為同一個副本, 循環引用保持循環 */
+#define HB_DUK_MAX_DEPTH     64
+#define HB_DUK_JULIAN_EPOCH  2440588.0    /* 1970-01-01 的 Julian 日 */
+#define HB_DUK_MS_PER_DAY    86400000.0
+#define HB_DUK_MAX_SAFE_INT  9007199254740992.0
+
+typedef struct
+{
+   void    *pDateCtor;     /* 首次遇到日期時取得, 避免每個值查找全局 Date */
+   void    *pDateProto;
+   void   **pSeen;         /* 已轉換的容器 [來源, 副本] 開放定址表, 首次遇到容器時配置 */
+   HB_SIZE  nSeen;
+   HB_SIZE  nSeenSize;     /* 表的槽數 (2 的冪) */
+   HB_BOOL  fItems;        /* 副本為 hb_itemNew 的項目 (JS -> Harbour), 結束時釋放 */
+   PHB_ITEM pKey;          /* JS -> Harbour 對象屬性名的暫存項目, 結束時釋放 */
+} HB_DUK_CONV;
+
+/* 共用或循環引用的容器只轉換一次, 其他引用指向同一個副本 */
+static HB_SIZE hb_duk_seen_slot(HB_DUK_CONV *conv, void *pKey)
+{
+   HB_SIZE nMask = conv->nSeenSize - 1;
+   HB_SIZE n = (HB_SIZE)(((HB_PTRUINT)pKey >> 4) * 2654435761U) & nMask;
+
+   while (conv->pSeen[n * 2] != NULL && conv->pSeen[n * 2] != pKey)
+   {
+      n = (n + 1) & nMask;
+   }
+   return n;
+}
+
+static void *hb_duk_seen_find(HB_DUK_CONV *conv, void *pKey)
+{
+   return conv->nSeen > 0 ? conv->pSeen[hb_duk_seen_slot(conv, pKey) * 2 + 1] : NULL;
+}
+
+static void hb_duk_seen_add(HB_DUK_CONV *conv, void *pKey, void *pValue)
+{
+   HB_SIZE n;
+
+   if ((conv->nSeen + 1) * 2 > conv->nSeenSize)
+   {
+      void **pOld = conv->pSeen;
+      HB_SIZE nOld = conv->nSeenSize;
+
+      conv->nSeenSize = nOld == 0 ? 16 : nOld * 2;
+      conv->pSeen = (void **)hb_xgrab(sizeof(void *) * 2 * conv->nSeenSize);
+      memset(conv->pSeen, 0, sizeof(void *) * 2 * conv->nSeenSize);
+      for (n = 0; n < nOld; n++)
+      {
+         if (pOld[n * 2] != NULL)
+         {
+            HB_SIZE nNew = hb_duk_seen_slot(conv, pOld[n * 2]);
+
+            conv->pSeen[nNew * 2] = pOld[n * 2];
+            conv->pSeen[nNew * 2 + 1] = pOld[n * 2 + 1];
+         }
+      }
+      if (pOld != NULL)
+      {
+         hb_xfree(pOld);
+      }
+   }
+   n = hb_duk_seen_slot(conv, pKey);
+   conv->pSeen[n * 2] = pKey;
+   conv->pSeen[n * 2 + 1] = pValue;
+   conv->nSeen++;
+}
+
+static void hb_duk_conv_release(HB_DUK_CONV *conv)
+{
+   HB_SIZE n;
+
+   if (conv->pKey != NULL)
+   {
+      hb_itemRelease(conv->pKey);
+      conv->pKey = NULL;
+   }
+   if (conv->pSeen == NULL)
+   {
+      return;
+   }
+   if (conv->fItems)
+   {
+      for (n = 0; n < conv->nSeenSize; n++)
+      {
+         if (conv->pSeen[n * 2] != NULL)
+         {
+            hb_itemRelease((PHB_ITEM)conv->pSeen[n * 2 + 1]);
+         }
+      }
+   }
+   hb_xfree(conv->pSeen);
+   conv->pSeen = NULL;
+   conv->nSeen = conv->nSeenSize = 0;
+}
+
+static void hb_duk_conv_date(duk_context *c, HB_DUK_CONV *conv)
+{
+   if (conv->pDateCtor == NULL)
+   {
+      duk_get_global_string(c, "Date");
+      conv->pDateCtor = duk_get_heapptr(c, -1);
+      duk_get_prop_string(c, -1, "prototype");
+      conv->pDateProto = duk_get_heapptr(c, -1);
+      duk_pop_2(c);
+   }
+}
+
+static void hb_duk_push_item_raw(duk_context *c, PHB_ITEM pItem, HB_DUK_CONV *conv, int iDepth)
+{
+   void *pSeen;
+
+   if (pItem == NULL || HB_IS_NIL(pItem))
+   {
+      duk_push_null(c);
+   }
+   else if (HB_IS_STRING(pItem))
+   {
+      const char *str = hb_itemGetCPtr(pItem);
+      HB_SIZE len = hb_itemGetCLen(pItem);
+      HB_UCHAR first = len > 0 ? (HB_UCHAR)str[0] : 0;
+
+      /* 以 0x80-0x82 或 0xFF 開頭的字串在 Duktape 中是 Symbol, 改用 buffer 保存 */
+      if (first == 0xFF || (first >= 0x80 && first <= 0x82))
+      {
+         memcpy(duk_push_fixed_buffer(c, len), str, len);
+      }
+      else
+      {
+         hb_duk_push_string_item(c, pItem);
+      }
+   }
+   else if (HB_IS_NUMINT(pItem))
+   {
+      duk_push_number(c, (duk_double_t)hb_itemGetNInt(pItem));
+   }
+   else if (HB_IS_NUMERIC(pItem))
+   {
+      duk_push_number(c, hb_itemGetND(pItem));
+   }
+   else if (HB_IS_LOGICAL(pItem))
+   {
+      duk_push_boolean(c, hb_itemGetL(pItem));
+   }
+   else if (HB_IS_DATETIME(pItem))
+   {
+      double dJulian = hb_itemGetTD(pItem);
+
+      if (dJulian == 0)
+      {
+         duk_push_null(c);   /* 空日期 */
+      }
+      else
+      {
+         hb_duk_conv_date(c, conv);
+         duk_push_heapptr(c, conv->pDateCtor);
+         duk_push_number(c, (dJulian - HB_DUK_JULIAN_EPOCH) * HB_DUK_MS_PER_DAY);
+         duk_new(c, 1);
+      }
+   }
+   else if ((HB_IS_ARRAY(pItem) || HB_IS_HASH(pItem)) &&
+            (pSeen = hb_duk_seen_find(conv, HB_IS_ARRAY(pItem) ? hb_arrayId(pItem) : hb_hashId(pItem))) != NULL)
+   {
+      duk_push_heapptr(c, pSeen);
+   }
+   else if (HB_IS_ARRAY(pItem) && iDepth < HB_DUK_MAX_DEPTH)
+   {
+      HB_SIZE nLen = hb_arrayLen(pItem), n;
+
+      duk_push_array(c);
+      hb_duk_seen_add(conv, hb_arrayId(pItem), duk_get_heapptr(c, -1));
+      for (n = 1; n <= nLen; n++)
+      {
+         hb_duk_push_item_raw(c, hb_arrayGetItemPtr(pItem, n), conv, iDepth + 1);
+         duk_put_prop_index(c, -2, (duk_uarridx_t)(n - 1));
+      }
+   }
+   else if (HB_IS_HASH(pItem) && iDepth < HB_DUK_MAX_DEPTH)
+   {
+      HB_SIZE nLen = hb_hashLen(pItem), n;
+
+      duk_push_object(c);
+      hb_duk_seen_add(conv, hb_hashId(pItem), duk_get_heapptr(c, -1));
+      for (n = 1; n <= nLen; n++)
+      {
+         PHB_ITEM pKey = hb_hashGetKeyAt(pItem, n);
+
+         if (HB_IS_STRING(pKey))
+         {
+            duk_push_lstring(c, hb_itemGetCPtr(pKey), hb_itemGetCLen(pKey));
+         }
+         else
+         {
+            hb_duk_push_item_raw(c, pKey, conv, HB_DUK_MAX_DEPTH);
+         }
+         hb_duk_push_item_raw(c, hb_hashGetValueAt(pItem, n), conv, iDepth + 1);
+         duk_put_prop(c, -3);
+      }
+   }
+   else if (HB_IS_POINTER(pItem))
+   {
+      duk_push_pointer(c, hb_itemGetPtr(pItem));
+   }
+   else
+   {
+      duk_push_undefined(c);
+   }
+}
+
+static void hb_duk_get_item_raw(duk_context *c, duk_idx_t idx, PHB_ITEM pItem, HB_DUK_CONV *conv, int iDepth)
+{
+   PHB_ITEM pSeen;
+
+   switch (duk_get_type(c, idx))
+   {
+      case DUK_TYPE_BOOLEAN:
+         hb_itemPutL(pItem, duk_get_boolean(c, idx) ? HB_TRUE : HB_FALSE);
+         break;
+
+      case DUK_TYPE_NUMBER:
+      {
+         double d = duk_get_number(c, idx);
+
+         /* 整數值返回 Harbour 整數, 其他返回 double */
+         if (d > -HB_DUK_MAX_SAFE_INT && d < HB_DUK_MAX_SAFE_INT && d == (double)(HB_MAXINT)d)
+         {
+            hb_itemPutNInt(pItem, (HB_MAXINT)d);
+         }
+         else
+         {
+            hb_itemPutND(pItem, d);
+         }
+         break;
+      }
+
+      case DUK_TYPE_STRING:
+      {
+         duk_size_t len;
+         const char *str = duk_get_lstring(c, idx, &len);
+
+         hb_itemPutCL(pItem, str, (HB_SIZE)len);
+         break;
+      }
+
+      case DUK_TYPE_BUFFER:
+      {
+         duk_size_t len;
+         void *data = duk_get_buffer(c, idx, &len);
+
+         hb_itemPutCL(pItem, (const char *)data, (HB_SIZE)len);
+         break;
+      }
+
+      case DUK_TYPE_POINTER:
+         hb_itemPutPtr(pItem, duk_get_pointer(c, idx));
+         break;
+
+      case DUK_TYPE_OBJECT:
+         idx = duk_normalize_index(c, idx);
+         if ((pSeen = (PHB_ITEM)hb_duk_seen_find(conv, duk_get_heapptr(c, idx))) != NULL)
+         {
+            hb_itemCopy(pItem, pSeen);
+         }
+         else if (iDepth >= HB_DUK_MAX_DEPTH || duk_is_function(c, idx))
+         {
+            hb_itemClear(pItem);
+         }
+         else if (duk_is_array(c, idx))
+         {
+            duk_size_t nLen = duk_get_length(c, idx), n;
+
+            hb_arrayNew(pItem, (HB_SIZE)nLen);
+            hb_duk_seen_add(conv, duk_get_heapptr(c, idx), hb_itemNew(pItem));
+            for (n = 0; n < nLen; n++)
+            {
+               duk_get_prop_index(c, idx, (duk_uarridx_t)n);
+               hb_duk_get_item_raw(c, -1, hb_arrayGetItemPtr(pItem, (HB_SIZE)n + 1), conv, iDepth + 1);
+               duk_pop(c);
+            }
+         }
+         else if (duk_is_buffer_data(c, idx))
+         {
+            duk_size_t len;
+            void *data = duk_get_buffer_data(c, idx, &len);
+
+            hb_itemPutCL(pItem, (const char *)data, (HB_SIZE)len);
+         }
+         else
+         {
+            hb_duk_conv_date(c, conv);
+            duk_get_prototype(c, idx);
+            if (duk_get_heapptr(c, -1) == conv->pDateProto)
+            {
+               double ms = 0;
+               HB_BOOL fValid = HB_FALSE;
+
+               duk_pop(c);
+               duk_get_prop_string(c, idx, "getTime");
+               duk_dup(c, idx);
+               if (duk_pcall_method(c, 0) == DUK_EXEC_SUCCESS && duk_is_number(c, -1))
+               {
+                  ms = duk_get_number(c, -1);
+                  fValid = ms == ms;   /* 排除 Invalid Date (NaN) */
+               }
+               if (fValid)
+               {
+                  hb_itemPutTD(pItem, ms / HB_DUK_MS_PER_DAY + HB_DUK_JULIAN_EPOCH);
+               }
+               else
+               {
+                  hb_itemClear(pItem);
+               }
+               duk_pop(c);
+               break;
+            }
+            duk_pop(c);
+
+            /* 屬性值直接轉換到雜湊的值項目中, getter 拋出錯誤時不會遺留暫存項目 */
+            if (conv->pKey == NULL)
+            {
+               conv->pKey = hb_itemNew(NULL);
+            }
+            hb_hashNew(pItem);
+            hb_duk_seen_add(conv, duk_get_heapptr(c, idx), hb_itemNew(pItem));
+            duk_enum(c, idx, DUK_ENUM_OWN_PROPERTIES_ONLY);
+            while (duk_next(c, -1, 1))
+            {
+               duk_size_t len;
+               const char *key = duk_get_lstring(c, -2, &len);
+
+               hb_itemPutCL(conv->pKey, key, (HB_SIZE)len);
+               hb_hashAdd(pItem, conv->pKey, NULL);
+               hb_duk_get_item_raw(c, -1, hb_hashGetItemPtr(pItem, conv->pKey, 0), conv, iDepth + 1);
+               duk_pop_2(c);
+            }
+            duk_pop(c);
+         }
+         break;
+
+      default:   /* undefined, null, none, lightfunc */
+         hb_itemClear(pItem);
+         break;
+   }
+}
+
+/* 受保護的值轉換: 轉換 JS 對象會執行 getter 和 Proxy trap, 推入 Harbour 值需要配置記憶體,
+ * 兩者都可能拋出錯誤 (包括 DUK_SET_MEMORY_LIMIT 的 RangeError). 在 duk_safe_call 中轉換,
+ * 錯誤不會越過 C 堆疊使進程中止, 轉換表也在失敗時釋放 */
+typedef struct
+{
+   PHB_ITEM    pItem;
+   HB_DUK_CONV conv;
+} HB_DUK_CONV_CALL;
+
+static duk_ret_t hb_duk_push_item_call(duk_context *c, void *udata)
+{
+   HB_DUK_CONV_CALL *call = (HB_DUK_CONV_CALL *)udata;
+
+   hb_duk_push_item_raw(c, call->pItem, &call->conv, 0);
+   return 1;
+}
+
+static duk_ret_t hb_duk_get_item_call(duk_context *c, void *udata)
+{
+   HB_DUK_CONV_CALL *call = (HB_DUK_CONV_CALL *)udata;
+
+   /* duk_safe_call 不建立新的堆疊框架, 索引 0 是調用者的底部; 參數在頂端 */
+   hb_duk_get_item_raw(c, -1, call->pItem, &call->conv, 0);
+   return 0;
+}
+
+/* 推入 Harbour 值; 失敗時改為推入錯誤對象並返回 HB_FALSE, 堆疊高度與成功時相同 */
+static HB_BOOL hb_duk_push_item_safe(duk_context *c, PHB_ITEM pItem)
+{
+   HB_DUK_CONV_CALL call;
+   duk_int_t rc;
+
+   memset(&call, 0, sizeof(call));
+   call.pItem = pItem;
+   rc = duk_safe_call(c, hb_duk_push_item_call, &call, 0, 1);
+   hb_duk_conv_release(&call.conv);
+   return rc == DUK_EXEC_SUCCESS;
+}
+
+/* 轉換堆疊中的值; 失敗時清除 pItem, 將錯誤對象推入堆疊頂端並返回 HB_FALSE */
+static HB_BOOL hb_duk_get_item_safe(duk_context *c, duk_idx_t idx, PHB_ITEM pItem)
+{
+   HB_DUK_CONV_CALL call;
+   duk_int_t rc;
+
+   memset(&call, 0, sizeof(call));
+   call.pItem = pItem;
+   call.conv.fItems = HB_TRUE;
+   duk_dup(c, idx);
+   rc = duk_safe_call(c, hb_duk_get_item_call, &call, 1, 1);
+   hb_duk_conv_release(&call.conv);
+   if (rc != DUK_EXEC_SUCCESS)
+   {
+      hb_itemClear(pItem);
+      return HB_FALSE;
+   }
+   duk_pop(c);
+   return HB_TRUE;
+}
+
+/* 自定義記憶體分配函數, udata 為 HB_DUK */
+static int hb_duk_slab_class(duk_size_t size)
+{
+   return (int)((size + sizeof(HB_DUK_BLOCK) - 1) / HB_DUK_SLAB_GRAIN);
+}
+
+/* 將新 slab 切成同級的塊並串入空閒表 */
+static HB_BOOL hb_duk_slab_grow(HB_DUK_SLAB *pSlab, int iClass)
+{
+   HB_SIZE nBlock = (HB_SIZE)(iClass + 1) * HB_DUK_SLAB_GRAIN;
+   char *pMem = (char *)hb_xalloc(HB_DUK_SLAB_SIZE), *pBlock, *pEnd;
+
+   if (pMem == NULL)
+   {
+      return HB_FALSE;
+   }
+   *(void **)pMem = pSlab->pSlabs;
+   pSlab->pSlabs = pMem;
+   pSlab->nSlabs++;
+
+   pEnd = pMem + HB_DUK_SLAB_SIZE - nBlock;
+   for (pBlock = pMem + sizeof(HB_DUK_BLOCK); pBlock <= pEnd; pBlock += nBlock)
+   {
+      *(void **)pBlock = pSlab->pFree[iClass];
+      pSlab->pFree[iClass] = pBlock;
+   }
+   return HB_TRUE;
+}
+
+static void hb_duk_slab_release(HB_DUK_SLAB *pSlab)
+{
+   while (pSlab->pSlabs != NULL)
+   {
+      void *pNext = *(void **)pSlab->pSlabs;
+
+      hb_xfree(pSlab->pSlabs);
+      pSlab->pSlabs = pNext;
+   }
+   memset(pSlab->pFree, 0, sizeof(pSlab->pFree));
+   pSlab->nSlabs = 0;
+}
+
+/* 超過上限時返回 NULL: Duktape 會先執行 (緊急) mark-and-sweep 再重試,
+ * 仍失敗則拋出 RangeError */
+static HB_BOOL hb_duk_mem_admit(PHB_DUK pDuk, duk_size_t nGrow)
+{
+   PHB_DUK_REALM pRealm = pDuk->pRealm;
+
+   if (pRealm != NULL && pRealm->nMemLimit != 0 &&
+       pRealm->nMemUsed + (HB_MAXINT)pDuk->nMemLive - (HB_MAXINT)pRealm->nMemMark + (HB_MAXINT)nGrow >
+       (HB_MAXINT)pRealm->nMemLimit)
+   {
+      return HB_FALSE;
+   }
+   return pDuk->nMemLimit == 0 ||
+          (nGrow <= pDuk->nMemLimit && pDuk->nMemLive <= pDuk->nMemLimit - nGrow);
+}
+
+/* 調整目前用量並更新峰值 */
+static void hb_duk_mem_resize(PHB_DUK pDuk, duk_size_t nOld, duk_size_t nNew)
+{
+   pDuk->nMemLive = pDuk->nMemLive - nOld + nNew;
+   if (pDuk->nMemLive > pDuk->nMemPeak)
+   {
+      pDuk->nMemPeak = pDuk->nMemLive;
+   }
+}
+
+static void *hb_duk_block_alloc(PHB_DUK pDuk, duk_size_t size)
+{
+   HB_DUK_SLAB *pSlab = &pDuk->slab;
+   HB_DUK_BLOCK *pBlock;
+
+   if (size <= HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK))
+   {
+      int iClass = hb_duk_slab_class(size);
+
+      if (pSlab->pFree[iClass] == NULL && !hb_duk_slab_grow(pSlab, iClass))
+      {
+         return NULL;
+      }
+      pBlock = (HB_DUK_BLOCK *)pSlab->pFree[iClass];
+      pSlab->pFree[iClass] = *(void **)pBlock;
+   }
+   else
+   {
+      pBlock = (HB_DUK_BLOCK *)hb_xalloc(sizeof(HB_DUK_BLOCK) + size);
+      if (pBlock == NULL)
+      {
+         return NULL;
+      }
+   }
+   pBlock->size = size;
+   hb_duk_mem_resize(pDuk, 0, size);
+   return (void *)(pBlock + 1);
+}
+
+static void hb_duk_block_free(PHB_DUK pDuk, void *ptr)
+{
+   HB_DUK_BLOCK *pBlock = (HB_DUK_BLOCK *)ptr - 1;
+
+   pDuk->nMemLive -= pBlock->size;
+
+   if (pBlock->size <= HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK))
+   {
+      int iClass = hb_duk_slab_class(pBlock->size);
+
+      *(void **)pBlock = pDuk->slab.pFree[iClass];
+      pDuk->slab.pFree[iClass] = pBlock;
+   }
+   else
+   {
+      hb_xfree(pBlock);
+   }
+}
+
+static void *hb_duktape_alloc(void *udata, duk_size_t size)
+{
+   PHB_DUK pDuk = (PHB_DUK)udata;
+   void *ptr = NULL;
+
+   if (size != 0)
+   {
+      pDuk->nAllocs++;
+      if (hb_duk_mem_admit(pDuk, size))
+      {
+         ptr = hb_duk_block_alloc(pDuk, size);
+      }
+      if (ptr == NULL)
+      {
+         pDuk->nAllocFails++;
+      }
+   }
+   return ptr;
+}
+
+static void hb_duktape_free(void *udata, void *ptr)
+{
+   if (ptr != NULL)
+   {
+      ((PHB_DUK)udata)->nFrees++;
+      hb_duk_block_free((PHB_DUK)udata, ptr);
+   }
+}
+
+static void *hb_duktape_realloc(void *udata, void *ptr, duk_size_t size)
+{
+   HB_DUK_BLOCK *pBlock;
+   duk_size_t nOld;
+   void *pNew;
+
+   if (ptr == NULL)
+   {
+      return hb_duktape_alloc(udata, size);
+   }
+   if (size == 0)
+   {
+      hb_duktape_free(udata, ptr);
+      return NULL;
+   }
+
+   ((PHB_DUK)udata)->nReallocs++;
+   pBlock = (HB_DUK_BLOCK *)ptr - 1;
+   nOld = pBlock->size;
+   if (size > nOld && !hb_duk_mem_admit((PHB_DUK)udata, size - nOld))
+   {
+      ((PHB_DUK)udata)->nAllocFails++;
+      return NULL;
+   }
+   if (nOld > HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK) &&
+       size > HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK))
+   {
+      /* 兩者皆為大塊, 直接交給 hb_xrealloc */
+      pBlock = (HB_DUK_BLOCK *)hb_xrealloc(pBlock, sizeof(HB_DUK_BLOCK) + size);
+      if (pBlock == NULL)
+      {
+         ((PHB_DUK)udata)->nAllocFails++;
+         return NULL;
+      }
+      pBlock->size = size;
+      hb_duk_mem_resize((PHB_DUK)udata, nOld, size);
+      return (void *)(pBlock + 1);
+   }
+   if (nOld <= HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK) &&
+       size <= HB_DUK_SLAB_MAX - sizeof(HB_DUK_BLOCK) &&
+       hb_duk_slab_class(nOld) == hb_duk_slab_class(size))
+   {
+      /* 同級塊可原地調整 */
+      pBlock->size = size;
+      hb_duk_mem_resize((PHB_DUK)udata, nOld, size);
+      return ptr;
+   }
+
+   /* 跨級: 上限只檢查增長部分, 失敗時原塊保持不變 */
+   pNew = hb_duk_block_alloc((PHB_DUK)udata, size);
+   if (pNew != NULL)
+   {
+      memcpy(pNew, ptr, nOld < size ? nOld : size);
+      hb_duk_block_free((PHB_DUK)udata, ptr);
+   }
+   else
+   {
+      ((PHB_DUK)udata)->nAllocFails++;
+   }
+   return pNew;
+}
+
+static void hb_duk_async_install(duk_context *c);
+static void hb_duk_jobs_clear(PHB_DUK pDuk);
+static void hb_duk_lat_free(PHB_DUK pDuk);
+
+/* 建立新的 Duktape heap, udata 指向 HB_DUK 以便回調函數取回狀態 */
+static PHB_DUK hb_duk_new(void)
+{
+   PHB_DUK pDuk = (PHB_DUK)hb_xgrab(sizeof(HB_DUK));
+
+   memset(pDuk, 0, sizeof(HB_DUK));
+   pDuk->cache.capacity = HB_DUK_EVAL_CACHE_DEFAULT;
+   pDuk->cache.head = pDuk->cache.tail = -1;
+
+   pDuk->ctx = pDuk->heap = duk_create_heap(hb_duktape_alloc, hb_duktape_realloc, hb_duktape_free, pDuk, NULL);
+   if (pDuk->ctx == NULL)
+   {
+      hb_duk_slab_release(&pDuk->slab);
+      hb_xfree(pDuk);
+      return NULL;
+   }
+   hb_duk_async_install(pDuk->ctx);
+   return pDuk;
+}
+
+/* 立即銷毀 heap, HB_DUK 本身保留到最後一個引用釋放 */
+static void hb_duk_destroy(PHB_DUK pDuk)
+{
+   if (s_pDefault == pDuk)
+   {
+      s_pDefault = NULL;
+   }
+   if (pDuk->ctx != NULL)
+   {
+      int i;
+
+      hb_duk_cache_release(&pDuk->cache);
+      duk_destroy_heap(pDuk->heap);
+      pDuk->ctx = pDuk->heap = NULL;
+      hb_duk_slab_release(&pDuk->slab);
+
+      for (i = 0; i < pDuk->iCallbacks; i++)
+      {
+         hb_itemRelease(pDuk->pCallbacks[i]);
+         hb_xfree(pDuk->pCallbackNames[i]);
+      }
+      if (pDuk->pCallbacks != NULL)
+      {
+         hb_xfree(pDuk->pCallbacks);
+         hb_xfree(pDuk->pCallbackNames);
+         pDuk->pCallbacks = NULL;
+         pDuk->pCallbackNames = NULL;
+      }
+      pDuk->iCallbacks = 0;
+      if (pDuk->pFuncFree != NULL)
+      {
+         hb_xfree(pDuk->pFuncFree);
+         pDuk->pFuncFree = NULL;
+      }
+      pDuk->pFuncStore = NULL;
+      pDuk->iFuncFree = pDuk->iFuncClean = pDuk->iFuncSlots = 0;
+      /* 剩餘的外部字串/緩衝區已在 duk_destroy_heap 中逐一解除釘選 */
+      if (pDuk->pPinned != NULL)
+      {
+         hb_xfree(pDuk->pPinned);
+         pDuk->pPinned = NULL;
+      }
+      pDuk->iPinned = pDuk->iPinnedMax = 0;
+      pDuk->pCheckpoint = NULL;
+      if (pDuk->pTimers != NULL)
+      {
+         hb_xfree(pDuk->pTimers);
+         pDuk->pTimers = NULL;
+      }
+      pDuk->iTimers = pDuk->iTimerMax = 0;
+      if (pDuk->pJobRealm != NULL)
+      {
+         hb_xfree(pDuk->pJobRealm);
+         pDuk->pJobRealm = NULL;
+      }
+      pDuk->nJobRealmMax = 0;
+      pDuk->pJobStore = pDuk->pTimerStore = NULL;
+      pDuk->nJobHead = pDuk->nJobTail = 0;
+      if (pDuk->pProfile != NULL)
+      {
+         hb_itemRelease(pDuk->pProfile);
+         pDuk->pProfile = NULL;
+      }
+      hb_duk_lat_free(pDuk);
+   }
+}
+
+static void hb_duk_release(PHB_DUK pDuk)
+{
+   if (hb_xRefDec(pDuk))
+   {
+      hb_duk_destroy(pDuk);
+      hb_xfree(pDuk);
+   }
+}
+
+/* 單調時鐘 (微秒) */
+static HB_MAXUINT hb_duk_clock_us(void)
+{
+#if defined(HB_OS_WIN)
+   static LARGE_INTEGER s_freq;
+   LARGE_INTEGER now;
+
+   if (s_freq.QuadPart == 0)
+   {
+      QueryPerformanceFrequency(&s_freq);
+   }
+   QueryPerformanceCounter(&now);
+   return (HB_MAXUINT)(now.QuadPart / s_freq.QuadPart) * 1000000 +
+          (HB_MAXUINT)(now.QuadPart % s_freq.QuadPart) * 1000000 / s_freq.QuadPart;
+#elif defined(HB_OS_UNIX) && defined(CLOCK_MONOTONIC)
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (HB_MAXUINT)ts.tv_sec * 1000000 + (HB_MAXUINT)(ts.tv_nsec / 1000);
+#else
+   return (HB_MAXUINT)clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+/* 由執行器中斷鉤子調用 (duk_config.h 的 DUK_USE_EXEC_TIMEOUT_CHECK),
+ * 逾時或取消後持續返回真, 直到錯誤完全傳出 Duktape */
+duk_bool_t hb_duk_exec_timeout_check(void *udata)
+{
+   PHB_DUK pDuk = (PHB_DUK)udata;
+
+   if (pDuk == NULL)
+   {
+      return 0;
+   }
+   if (pDuk->fCancel)
+   {
+      return 1;
+   }
+   return pDuk->nDeadline != 0 && hb_duk_clock_us() >= pDuk->nDeadline;
+}
+
+typedef struct
+{
+   HB_MAXUINT     nDeadline;   /* 外層截止時間 */
+   PHB_DUK_REALM  pRealm;      /* 外層 realm */
+   HB_MAXUINT     nStart;      /* 啟用延遲直方圖時的開始時間, 否則為 0 */
+} HB_DUK_EXEC;
+
+/* 結算正在執行的 realm 自上次計帳以來的淨增長 */
+static void hb_duk_realm_charge(PHB_DUK pDuk)
+{
+   PHB_DUK_REALM pRealm = pDuk->pRealm;
+
+   if (pRealm != NULL)
+   {
+      pRealm->nMemUsed += (HB_MAXINT)pDuk->nMemLive - (HB_MAXINT)pRealm->nMemMark;
+      if (pRealm->nMemUsed < 0)
+      {
+         pRealm->nMemUsed = 0;   /* 期間回收了其他環境的垃圾 */
+      }
+      pRealm->nMemMark = pDuk->nMemLive;
+   }
+}
+
+/* 切換正在執行的 realm (NULL 為 heap 本身的環境) */
+static void hb_duk_realm_switch(PHB_DUK pDuk, PHB_DUK_REALM pRealm)
+{
+   hb_duk_realm_charge(pDuk);
+   pDuk->pRealm = pRealm;
+   if (pRealm != NULL)
+   {
+      pRealm->nMemMark = pDuk->nMemLive;
+   }
+}
+
+/* 進入一次執行: nTimeoutMs <= 0 時使用 realm 或 heap 預設值, 巢狀調用取較早的截止時間;
+ * 取消請求只作用於當時正在進行的執行 */
+static void hb_duk_exec_begin(PHB_DUK pDuk, PHB_DUK_REALM pRealm, HB_MAXINT nTimeoutMs, HB_DUK_EXEC *pExec)
+{
+   HB_MAXUINT nPrev = pDuk->nDeadline;
+
+   pExec->nStart = pDuk->pLatency != NULL ? hb_duk_clock_us() : 0;
+   pExec->nDeadline = nPrev;
+   pExec->pRealm = pDuk->pRealm;
+   hb_duk_realm_switch(pDuk, pRealm);
+
+   if (nTimeoutMs <= 0 && pRealm != NULL)
+   {
+      nTimeoutMs = pRealm->nTimeout;
+   }
+   if (nTimeoutMs <= 0)
+   {
+      nTimeoutMs = pDuk->nTimeout;
+   }
+   if (nTimeoutMs > 0)
+   {
+      HB_MAXUINT nDeadline = hb_duk_clock_us() + (HB_MAXUINT)nTimeoutMs * 1000;
+
+      if (nPrev == 0 || nDeadline < nPrev)
+      {
+         pDuk->nDeadline = nDeadline;
+      }
+   }
+   if (pDuk->iExecDepth++ == 0)
+   {
+      pDuk->fCancel = 0;
+   }
+}
+
+/* 離開執行: 恢復外層截止時間與 realm, 最外層結束時清除取消請求 */
+static void hb_duk_exec_end(PHB_DUK pDuk, HB_DUK_EXEC *pExec)
+{
+   pDuk->nDeadline = pExec->nDeadline;
+   hb_duk_realm_switch(pDuk, pExec->pRealm);
+   if (--pDuk->iExecDepth == 0)
+   {
+      pDuk->fCancel = 0;
+   }
+}
+
+/* 延遲值 (微秒) 所在的分格 */
+static int hb_duk_lat_bucket(HB_MAXUINT nValue)
+{
+   int iShift = 0;
+
+   if (nValue < 2 * HB_DUK_LAT_SUB)
+   {
+      return (int)nValue;
+   }
+   while ((nValue >> iShift) >= 2 * HB_DUK_LAT_SUB)
+   {
+      iShift++;
+   }
+   return iShift * HB_DUK_LAT_SUB + (int)(nValue >> iShift);
+}
+
+/* 分格所含的最大值 */
+static HB_MAXUINT hb_duk_lat_bucket_high(int iBucket)
+{
+   int iShift;
+
+   if (iBucket < 2 * HB_DUK_LAT_SUB)
+   {
+      return (HB_MAXUINT)iBucket;
+   }
+   iShift = iBucket / HB_DUK_LAT_SUB - 1;
+   return ((HB_MAXUINT)(iBucket - iShift * HB_DUK_LAT_SUB + 1) << iShift) - 1;
+}
+
+static void hb_duk_lat_free(PHB_DUK pDuk)
+{
+   int i;
+
+   if (pDuk->pLatency == NULL)
+   {
+      return;
+   }
+   for (i = 0; i < HB_DUK_LAT_TABLE; i++)
+   {
+      HB_DUK_LAT *pLat = pDuk->pLatency[i];
+
+      while (pLat != NULL)
+      {
+         HB_DUK_LAT *pNext = pLat->pNext;
+
+         hb_xfree(pLat);
+         pLat = pNext;
+      }
+   }
+   hb_xfree(pDuk->pLatency);
+   pDuk->pLatency = NULL;
+   pDuk->iLatency = 0;
+}
+
+/* 以空白的名稱表開始記錄 */
+static void hb_duk_lat_start(PHB_DUK pDuk)
+{
+   hb_duk_lat_free(pDuk);
+   pDuk->pLatency = (HB_DUK_LAT **)hb_xgrab(sizeof(HB_DUK_LAT *) * HB_DUK_LAT_TABLE);
+   memset(pDuk->pLatency, 0, sizeof(HB_DUK_LAT *) * HB_DUK_LAT_TABLE);
+}
+
+/* 將 nStart 起的經過時間記入 szKind + name 的直方圖 */
+static void hb_duk_lat_record(PHB_DUK pDuk, HB_MAXUINT nStart, const char *szKind, const char *name, HB_SIZE len)
+{
+   HB_MAXUINT nElapsed;
+   char key[HB_DUK_LAT_KEY];
+   HB_SIZE nKind, nKey;
+   HB_U32 nHash;
+   HB_DUK_LAT *pLat;
+
+   if (nStart == 0 || pDuk->pLatency == NULL)
+   {
+      return;
+   }
+   nElapsed = hb_duk_clock_us() - nStart;
+
+   nKind = strlen(szKind);
+   if (len > sizeof(key) - nKind)
+   {
+      len = sizeof(key) - nKind;
+   }
+   memcpy(key, szKind, nKind);
+   memcpy(key + nKind, name, len);
+   nKey = nKind + len;
+   nHash = hb_duk_hash(key, nKey);
+
+   pLat = pDuk->pLatency[nHash % HB_DUK_LAT_TABLE];
+   while (pLat != NULL && (pLat->nHash != nHash || pLat->nLen != nKey || memcmp(pLat->szName, key, nKey) != 0))
+   {
+      pLat = pLat->pNext;
+   }
+   if (pLat == NULL)
+   {
+      /* 名稱過多 (例如每次都不同的動態代碼) 時併入同一個直方圖, 它本身不受上限限制 */
+      if (pDuk->iLatency >= HB_DUK_LAT_MAX && (nKey != 7 || memcmp(key, "(other)", 7) != 0))
+      {
+         hb_duk_lat_record(pDuk, nStart, "(other)", "", 0);
+         return;
+      }
+      pLat = (HB_DUK_LAT *)hb_xgrab(sizeof(HB_DUK_LAT) + nKey);
+      memset(pLat, 0, sizeof(HB_DUK_LAT));
+      memcpy(pLat->szName, key, nKey);
+      pLat->szName[nKey] = '\0';
+      pLat->nLen = nKey;
+      pLat->nHash = nHash;
+      pLat->nMin = nElapsed;
+      pLat->pNext = pDuk->pLatency[nHash % HB_DUK_LAT_TABLE];
+      pDuk->pLatency[nHash % HB_DUK_LAT_TABLE] = pLat;
+      pDuk->iLatency++;
+   }
+
+   pLat->nCount++;
+   pLat->nSum += nElapsed;
+   if (nElapsed < pLat->nMin)
+   {
+      pLat->nMin = nElapsed;
+   }
+   if (nElapsed > pLat->nMax)
+   {
+      pLat->nMax = nElapsed;
+   }
+   pLat->nBuckets[hb_duk_lat_bucket(nElapsed)]++;
+}
+
+/* eval 以源碼雜湊命名 */
+static void hb_duk_lat_record_eval(PHB_DUK pDuk, HB_MAXUINT nStart, const char *code, HB_SIZE len)
+{
+   char szHash[16];
+
+   if (nStart == 0 || pDuk->pLatency == NULL)
+   {
+      return;
+   }
+   hb_snprintf(szHash, sizeof(szHash), "%08x", (unsigned int)hb_duk_hash(code, len));
+   hb_duk_lat_record(pDuk, nStart, "eval:", szHash, strlen(szHash));
+}
+
+/* 從 heap udata 取回 HB_DUK */
+static PHB_DUK hb_duk_from_ctx(duk_context *c)
+{
+   duk_memory_functions funcs;
+
+   duk_get_memory_functions(c, &funcs);
+   return (PHB_DUK)funcs.udata;
+}
+
+/* DUK_REGISTER_FUNCTION 的共用入口: magic 為代碼塊槽位,
+ * JS 參數直接推入 Harbour VM 堆疊後執行代碼塊 */
+static duk_ret_t hb_duk_trampoline(duk_context *c)
+{
+   PHB_DUK pDuk = hb_duk_from_ctx(c);
+   duk_idx_t nArgs = duk_get_top(c), i;
+   duk_int_t iSlot = duk_get_current_magic(c);
+   HB_MAXUINT nStart = pDuk->pLatency != NULL ? hb_duk_clock_us() : 0;
+   PHB_ITEM pArgs = NULL;
+
+   /* 先轉換對象和數組參數: 轉換可能拋出錯誤, 此時 VM 堆疊尚未推入任何項目.
+    * 每次調用使用自己的陣列, 回調中再調用 JS 的巢狀回調互不干擾 */
+   for (i = 0; i < nArgs; i++)
+   {
+      if (duk_check_type_mask(c, i, DUK_TYPE_MASK_BOOLEAN | DUK_TYPE_MASK_STRING | DUK_TYPE_MASK_UNDEFINED | DUK_TYPE_MASK_NULL))
+      {
+         continue;
+      }
+      if (pArgs == NULL)
+      {
+         pArgs = hb_itemArrayNew((HB_SIZE)nArgs);
+      }
+      if (!hb_duk_get_item_safe(c, i, hb_arrayGetItemPtr(pArgs, (HB_SIZE)i + 1)))
+      {
+         hb_itemRelease(pArgs);
+         return duk_throw(c);
+      }
+   }
+
+   hb_vmPushEvalSym();
+   hb_vmPush(pDuk->pCallbacks[iSlot]);
+   for (i = 0; i < nArgs; i++)
+   {
+      switch (duk_get_type(c, i))
+      {
+         case DUK_TYPE_BOOLEAN:
+            hb_vmPushLogical(duk_get_boolean(c, i) ? HB_TRUE : HB_FALSE);
+            break;
+
+         case DUK_TYPE_STRING:
+         {
+            duk_size_t len;
+            const char *str = duk_get_lstring(c, i, &len);
+
+            hb_vmPushString(str, (HB_SIZE)len);
+            break;
+         }
+
+         case DUK_TYPE_UNDEFINED:
+         case DUK_TYPE_NULL:
+            hb_vmPushNil();
+            break;
+
+         default:
+            hb_vmPush(hb_arrayGetItemPtr(pArgs, (HB_SIZE)i + 1));
+            break;
+      }
+   }
+   if (pArgs != NULL)
+   {
+      hb_itemRelease(pArgs);
+   }
+   pDuk->iCallDepth++;
+   hb_vmSend((HB_USHORT)nArgs);
+   pDuk->iCallDepth--;
+   hb_duk_lat_record(pDuk, nStart, "callback:", pDuk->pCallbackNames[iSlot], strlen(pDuk->pCallbackNames[iSlot]));
+
+   if (hb_vmRequestQuery() != 0)
+   {
+      return duk_error(c, DUK_ERR_ERROR, "Harbour callback interrupted");
+   }
+
+   if (!hb_duk_push_item_safe(c, hb_stackReturnItem()))
+   {
+      return duk_throw(c);
+   }
+   hb_duk_exec_yield(pDuk, c);   /* 回調返回處也是任務的讓出點 */
+   return 1;
+}
+
+/* 註冊 Duktape 對象到 Harbour 垃圾回收 */
+static HB_GARBAGE_FUNC(hb_duktape_gc)
+{
+   PHB_DUK *ph = (PHB_DUK *)Cargo;
+
+   /* Check if pointer is not NULL to avoid multiple freeing */
+   if (ph && *ph)
+   {
+      /* Release the heap */
+      hb_duk_release(*ph);
+
+      /* set pointer to NULL to avoid multiple freeing */
+      *ph = NULL;
+   }
+}
+
+static const HB_GC_FUNCS s_gcDuktapeFuncs =
+{
+   hb_duktape_gc,
+   hb_gcDummyMark
+};
+
+static void hb_duk_retheap(PHB_DUK pDuk)
+{
+   PHB_DUK *ph = (PHB_DUK *)hb_gcAllocate(sizeof(PHB_DUK), &s_gcDuktapeFuncs);
+
+   *ph = pDuk;
+   hb_retptrGC(ph);
+}
+
+/* 函數句柄: 函數釘選在 heap stash 的槽位中, 調用時直接以 heapptr 推入 */
+typedef struct
+{
+   PHB_DUK  pDuk;
+   PHB_DUK_REALM pRealm;   /* 從 realm 取得的函數在該 realm 的執行緒上調用, 持有引用 */
+   void    *heapptr;
+   int      iSlot;
+   char    *szName;    /* 查找時的名稱, 用於延遲統計 */
+} HB_DUK_FUNC, *PHB_DUK_FUNC;
+
+/* GC 可能在任意時刻執行, 此處不觸碰 JS heap, 槽位留待下次配置時清除 */
+static HB_GARBAGE_FUNC(hb_duk_func_gc)
+{
+   PHB_DUK_FUNC pFunc = (PHB_DUK_FUNC)Cargo;
+
+   if (pFunc->pDuk != NULL)
+   {
+      if (pFunc->pDuk->ctx != NULL && pFunc->iSlot >= 0)
+      {
+         pFunc->pDuk->pFuncFree[pFunc->pDuk->iFuncFree++] = pFunc->iSlot;
+      }
+      hb_duk_release(pFunc->pDuk);
+      pFunc->pDuk = NULL;
+   }
+   if (pFunc->pRealm != NULL)
+   {
+      hb_gcRefFree(pFunc->pRealm);
+      pFunc->pRealm = NULL;
+   }
+   if (pFunc->szName != NULL)
+   {
+      hb_xfree(pFunc->szName);
+      pFunc->szName = NULL;
+   }
+}
+
+static const HB_GC_FUNCS s_gcDukFuncFuncs =
+{
+   hb_duk_func_gc,
+   hb_gcDummyMark
+};
+
+/* 將堆疊頂端的函數釘選到槽位並彈出, 返回槽位編號 */
+static int hb_duk_func_pin(PHB_DUK pDuk)
+{
+   duk_context *c = pDuk->ctx;
+   int iSlot;
+
+   if (pDuk->pFuncStore == NULL)
+   {
+      duk_push_heap_stash(c);
+      duk_push_array(c);
+      pDuk->pFuncStore = duk_get_heapptr(c, -1);
+      duk_put_prop_string(c, -2, "hbFuncHandles");
+      duk_pop(c);
+   }
+
+   duk_push_heapptr(c, pDuk->pFuncStore);
+   while (pDuk->iFuncClean < pDuk->iFuncFree)
+   {
+      duk_del_prop_index(c, -1, (duk_uarridx_t)pDuk->pFuncFree[pDuk->iFuncClean++]);
+   }
+
+   if (pDuk->iFuncFree > 0)
+   {
+      iSlot = pDuk->pFuncFree[--pDuk->iFuncFree];
+      pDuk->iFuncClean = pDuk->iFuncFree;
+   }
+   else
+   {
+      /* 空閒表容量與槽位總數一致, GC 歸還時無須重新配置 */
+      iSlot = pDuk->iFuncSlots++;
+      pDuk->pFuncFree = (int *)hb_xrealloc(pDuk->pFuncFree, sizeof(int) * pDuk->iFuncSlots);
+   }
+
+   duk_swap_top(c, -2);
+   duk_put_prop_index(c, -2, (duk_uarridx_t)iSlot);
+   duk_pop(c);
+   return iSlot;
+}
+
+/* 已回收的 realm 排入的工作及計時器改指向此處, 到期時略過不執行 */
+static HB_DUK_REALM s_realmGone;
+
+static void hb_duk_jobs_orphan(PHB_DUK pDuk, PHB_DUK_REALM pRealm)
+{
+   duk_uarridx_t n;
+   int i;
+
+   for (n = pDuk->nJobHead; n < pDuk->nJobTail; n++)
+   {
+      if (pDuk->pJobRealm[n] == pRealm)
+      {
+         pDuk->pJobRealm[n] = &s_realmGone;
+      }
+   }
+   for (i = 0; i < pDuk->iTimers; i++)
+   {
+      if (pDuk->pTimers[i].pRealm == pRealm)
+      {
+         pDuk->pTimers[i].pRealm = &s_realmGone;
+      }
+   }
+}
+
+/* Realm 句柄: 與函數句柄相同, GC 時只歸還槽位, 執行緒留待下次配置時解除釘選 */
+static HB_GARBAGE_FUNC(hb_duk_realm_gc)
+{
+   PHB_DUK_REALM pRealm = (PHB_DUK_REALM)Cargo;
+
+   if (pRealm->pDuk != NULL)
+   {
+      hb_duk_jobs_orphan(pRealm->pDuk, pRealm);
+      if (pRealm->pDuk->ctx != NULL && pRealm->iSlot >= 0)
+      {
+         pRealm->pDuk->pFuncFree[pRealm->pDuk->iFuncFree++] = pRealm->iSlot;
+      }
+      hb_duk_cache_release(&pRealm->cache);
+      hb_duk_release(pRealm->pDuk);
+      pRealm->pDuk = NULL;
+      pRealm->ctx = NULL;
+   }
+}
+
+static const HB_GC_FUNCS s_gcDukRealmFuncs =
+{
+   hb_duk_realm_gc,
+   hb_gcDummyMark
+};
+
+/* Harbour 執行緒 heap 池: 啟用後每個執行緒在 TSD 中持有自己的 heap */
+typedef struct
+{
+   PHB_DUK pDuk;
+} HB_DUK_TSD;
+
+static void hb_duk_tsd_release(void *cargo);
+
+static HB_TSD_NEW(s_dukTSD, sizeof(HB_DUK_TSD), NULL, hb_duk_tsd_release);
+static HB_CRITICAL_NEW(s_poolMtx);
+
+static HB_BOOL  s_fPool = HB_FALSE;
+static PHB_DUK *s_pPool = NULL;        /* 閒置的 heap */
+static int      s_iPoolIdle = 0;
+static int      s_iPoolCount = 0;      /* 池建立且尚未銷毀的 heap 數 */
+static int      s_iPoolMax = 0;
+static char    *s_pszBootstrap = NULL;
+
+/* 建立新的池 heap 並執行啟動腳本, 呼叫前已預留 s_iPoolCount */
+static PHB_DUK hb_duk_pool_new(const char *bootstrap)
+{
+   PHB_DUK pDuk = hb_duk_new();
+
+   if (pDuk != NULL && bootstrap != NULL)
+   {
+      if (duk_peval_string(pDuk->ctx, bootstrap) != 0)
+      {
+         hb_duk_release(pDuk);
+         pDuk = NULL;
+      }
+      else
+      {
+         duk_pop(pDuk->ctx);
+      }
+   }
+   if (pDuk == NULL)
+   {
+      hb_threadEnterCriticalSection(&s_poolMtx);
+      s_iPoolCount--;
+      hb_threadLeaveCriticalSection(&s_poolMtx);
+   }
+   return pDuk;
+}
+
+/* 從池中取出閒置 heap, 沒有時在上限內建立新的 */
+static PHB_DUK hb_duk_pool_acquire(void)
+{
+   PHB_DUK pDuk = NULL;
+   char *bootstrap = NULL;
+   HB_BOOL fCreate = HB_FALSE;
+
+   hb_threadEnterCriticalSection(&s_poolMtx);
+   if (s_fPool)
+   {
+      if (s_iPoolIdle > 0)
+      {
+         pDuk = s_pPool[--s_iPoolIdle];
+      }
+      else if (s_iPoolCount < s_iPoolMax)
+      {
+         s_iPoolCount++;
+         fCreate = HB_TRUE;
+         if (s_pszBootstrap != NULL)
+         {
+            bootstrap = hb_strdup(s_pszBootstrap);
+         }
+      }
+   }
+   hb_threadLeaveCriticalSection(&s_poolMtx);
+
+   if (fCreate)
+   {
+      pDuk = hb_duk_pool_new(bootstrap);
+      if (bootstrap != NULL)
+      {
+         hb_xfree(bootstrap);
+      }
+   }
+   return pDuk;
+}
+
+/* 將 heap 歸還池中, 已銷毀或池已關閉時釋放 */
+static void hb_duk_pool_return(PHB_DUK pDuk)
+{
+   HB_BOOL fKeep = HB_FALSE;
+
+   hb_threadEnterCriticalSection(&s_poolMtx);
+   if (pDuk->ctx != NULL && s_fPool && s_iPoolIdle < s_iPoolMax)
+   {
+      s_pPool[s_iPoolIdle++] = pDuk;
+      fKeep = HB_TRUE;
+   }
+   else
+   {
+      s_iPoolCount--;
+   }
+   hb_threadLeaveCriticalSection(&s_poolMtx);
+
+   if (!fKeep)
+   {
+      hb_duk_release(pDuk);
+   }
+}
+
+/* 執行緒結束時將其 heap 歸還池中 */
+static void hb_duk_tsd_release(void *cargo)
+{
+   HB_DUK_TSD *pTSD = (HB_DUK_TSD *)cargo;
+
+   if (pTSD->pDuk != NULL)
+   {
+      hb_duk_pool_return(pTSD->pDuk);
+      pTSD->pDuk = NULL;
+   }
+}
+
+/* 未指定 heap 時使用的 heap: 池模式下為目前執行緒的 heap */
+static PHB_DUK hb_duk_default(void)
+{
+   if (s_fPool)
+   {
+      HB_DUK_TSD *pTSD = (HB_DUK_TSD *)hb_stackGetTSD(&s_dukTSD);
+
+      if (pTSD->pDuk != NULL && pTSD->pDuk->ctx == NULL)
+      {
+         hb_duk_pool_return(pTSD->pDuk);
+         pTSD->pDuk = NULL;
+      }
+      if (pTSD->pDuk == NULL)
+      {
+         pTSD->pDuk = hb_duk_pool_acquire();
+      }
+      return pTSD->pDuk;
+   }
+   return s_pDefault;
+}
+
+/* 第一個參數為 realm 句柄時返回之 */
+static PHB_DUK_REALM hb_duk_realm_param(void)
+{
+   PHB_DUK_REALM pRealm = (PHB_DUK_REALM)hb_parptrGC(&s_gcDukRealmFuncs, 1);
+
+   return pRealm != NULL && pRealm->pDuk != NULL ? pRealm : NULL;
+}
+
+/* 第一個參數為 heap 指標或 realm 句柄時使用該 heap 並將 *piBase 設為 1, 否則使用預設 heap */
+static PHB_DUK hb_duk_param(int *piBase)
+{
+   PHB_DUK *ph = (PHB_DUK *)hb_parptrGC(&s_gcDuktapeFuncs, 1);
+   PHB_DUK_REALM pRealm;
+
+   if (ph != NULL)
+   {
+      *piBase = 1;
+      return *ph;
+   }
+   pRealm = hb_duk_realm_param();
+   if (pRealm != NULL)
+   {
+      *piBase = 1;
+      return pRealm->pDuk;
+   }
+   *piBase = 0;
+   return hb_duk_default();
+}
+
+/* 執行用的 context: 第一個參數為 realm 句柄時為其執行緒 */
+static duk_context *hb_duk_param_ctx(PHB_DUK pDuk, PHB_DUK_REALM pRealm)
+{
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      return NULL;
+   }
+   return pRealm != NULL ? pRealm->ctx : pDuk->ctx;
+}
+
+static duk_context *hb_duk_ctx(int *piBase)
+{
+   PHB_DUK pDuk = hb_duk_param(piBase);
+
+   return hb_duk_param_ctx(pDuk, hb_duk_realm_param());
+}
+
+/* 初始化 Duktape 引擎並註冊到 Harbour 垃圾回收 */
+HB_FUNC(DUK_INIT)
+{
+   PHB_DUK pDuk;
+
+   if (s_fPool)
+   {
+      /* 池模式: 返回目前執行緒的 heap */
+      pDuk = hb_duk_default();
+      if (pDuk == NULL)
+      {
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+      hb_xRefInc(pDuk);
+      hb_duk_retheap(pDuk);
+      return;
+   }
+
+   if (s_pDefault != NULL)
+   {
+      hb_retl(HB_TRUE);
+      return;
+   }
+
+   pDuk = hb_duk_new();
+   if (pDuk == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 註冊到 Harbour 垃圾回收 */
+   s_pDefault = pDuk;
+   hb_duk_retheap(pDuk);
+}
+
+/* 建立獨立的 Duktape heap, 其他 DUK_* 函數以第一個參數傳入 */
+HB_FUNC(DUK_CREATE_HEAP)
+{
+   PHB_DUK pDuk = hb_duk_new();
+
+   if (pDuk == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_retheap(pDuk);
+}
+
+/* 建立 realm: 共用 heap 的分配器與字串表, 擁有獨立的全局對象及內建對象
+ * DUK_REALM_NEW([hHeap,] [nMemLimit], [nTimeoutMs]), 返回的句柄可取代 hHeap 傳給其他 DUK_* 函數 */
+HB_FUNC(DUK_REALM_NEW)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   HB_MAXINT nMemLimit = hb_parnint(iBase + 1);
+   HB_MAXINT nTimeout = hb_parnint(iBase + 2);
+   PHB_DUK_REALM pRealm;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (nMemLimit < 0 || nTimeout < 0)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pRealm = (PHB_DUK_REALM)hb_gcAllocate(sizeof(HB_DUK_REALM), &s_gcDukRealmFuncs);
+   memset(pRealm, 0, sizeof(HB_DUK_REALM));
+   pRealm->cache.capacity = HB_DUK_REALM_CACHE_DEFAULT;
+   pRealm->cache.head = pRealm->cache.tail = -1;
+   pRealm->nMemLimit = (duk_size_t)nMemLimit;
+   pRealm->nTimeout = nTimeout;
+
+   /* 執行緒以函數句柄的槽位釘選 */
+   duk_push_thread_new_globalenv(pDuk->ctx);
+   pRealm->ctx = duk_get_context(pDuk->ctx, -1);
+   hb_duk_async_install(pRealm->ctx);
+   pRealm->iSlot = hb_duk_func_pin(pDuk);
+   pRealm->pDuk = pDuk;
+   hb_xRefInc(pDuk);
+   hb_retptrGC(pRealm);
+}
+
+/* 獲取 realm 資源使用: { 記憶體用量 (近似), 記憶體預算, 逾時 } */
+HB_FUNC(DUK_REALM_INFO)
+{
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   PHB_ITEM pArray;
+
+   if (pRealm == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pArray = hb_itemArrayNew(3);
+   hb_arraySetNInt(pArray, 1, pRealm->nMemUsed);
+   hb_arraySetNInt(pArray, 2, (HB_MAXINT)pRealm->nMemLimit);
+   hb_arraySetNInt(pArray, 3, pRealm->nTimeout);
+
+   hb_itemReturn(pArray);
+   hb_itemRelease(pArray);
+}
+
+/* 啟用執行緒 heap 池: DUK_POOL_INIT(nMaxHeaps, [cBootstrap], [nPrewarm]) */
+HB_FUNC(DUK_POOL_INIT)
+{
+   int iMax = hb_parni(1);
+   const char *bootstrap = hb_parc(2);
+   int iPrewarm = hb_parni(3);
+   int i;
+
+   if (iMax <= 0 || s_fPool)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_threadEnterCriticalSection(&s_poolMtx);
+   s_pPool = (PHB_DUK *)hb_xgrab(sizeof(PHB_DUK) * iMax);
+   s_iPoolIdle = s_iPoolCount = 0;
+   s_iPoolMax = iMax;
+   s_pszBootstrap = bootstrap != NULL ? hb_strdup(bootstrap) : NULL;
+   s_fPool = HB_TRUE;
+   hb_threadLeaveCriticalSection(&s_poolMtx);
+
+   /* 預熱: 預先建立 heap 並執行啟動腳本 */
+   if (iPrewarm > iMax)
+   {
+      iPrewarm = iMax;
+   }
+   for (i = 0; i < iPrewarm; i++)
+   {
+      PHB_DUK pDuk;
+
+      hb_threadEnterCriticalSection(&s_poolMtx);
+      s_iPoolCount++;
+      hb_threadLeaveCriticalSection(&s_poolMtx);
+
+      pDuk = hb_duk_pool_new(bootstrap);
+      if (pDuk == NULL)
+      {
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+      hb_duk_pool_return(pDuk);
+   }
+
+   hb_retl(HB_TRUE);
+}
+
+/* 獲取 heap 池統計: { 已建立, 閒置, 上限 } */
+HB_FUNC(DUK_POOL_STATS)
+{
+   PHB_ITEM pArray = hb_itemArrayNew(3);
+
+   hb_threadEnterCriticalSection(&s_poolMtx);
+   hb_arraySetNInt(pArray, 1, s_iPoolCount);
+   hb_arraySetNInt(pArray, 2, s_iPoolIdle);
+   hb_arraySetNInt(pArray, 3, s_iPoolMax);
+   hb_threadLeaveCriticalSection(&s_poolMtx);
+
+   hb_itemReturn(pArray);
+   hb_itemRelease(pArray);
+}
+
+/* 關閉 heap 池, 銷毀閒置的 heap; 使用中的 heap 在執行緒結束時釋放 */
+HB_FUNC(DUK_POOL_CLOSE)
+{
+   PHB_DUK *pPool;
+   int iIdle, i;
+
+   hb_threadEnterCriticalSection(&s_poolMtx);
+   pPool = s_pPool;
+   iIdle = s_iPoolIdle;
+   s_pPool = NULL;
+   s_iPoolIdle = 0;
+   s_iPoolCount -= iIdle;
+   s_fPool = HB_FALSE;
+   if (s_pszBootstrap != NULL)
+   {
+      hb_xfree(s_pszBootstrap);
+      s_pszBootstrap = NULL;
+   }
+   hb_threadLeaveCriticalSection(&s_poolMtx);
+
+   for (i = 0; i < iIdle; i++)
+   {
+      hb_duk_release(pPool[i]);
+   }
+   if (pPool != NULL)
+   {
+      hb_xfree(pPool);
+   }
+   hb_retl(HB_TRUE);
+}
+
+/* 執行 JavaScript 代碼: DUK_EVAL([hHeap,] cCode, [nTimeoutMs]) */
+HB_FUNC(DUK_EVAL)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *code = hb_parc(iBase + 1);
+   const char *error;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (code == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_exec_begin(pDuk, pRealm, hb_parnint(iBase + 2), &exec);
+   rc = hb_duk_peval_cached(ctx, pRealm != NULL ? &pRealm->cache : &pDuk->cache, code, hb_parclen(iBase + 1));
+   hb_duk_exec_end(pDuk, &exec);
+   hb_duk_lat_record_eval(pDuk, exec.nStart, code, hb_parclen(iBase + 1));
+   if (rc != 0)
+   {
+      error = duk_safe_to_string(ctx, -1);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   hb_duk_retstr(ctx, -1);
+   duk_pop(ctx);
+}
+
+/* 執行 JavaScript 代碼並以 Harbour 原生類型返回結果: DUK_EVAL_VALUE([hHeap,] cCode, [nTimeoutMs]) */
+HB_FUNC(DUK_EVAL_VALUE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *code = hb_parc(iBase + 1);
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (code == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_exec_begin(pDuk, pRealm, hb_parnint(iBase + 2), &exec);
+   rc = hb_duk_peval_cached(ctx, pRealm != NULL ? &pRealm->cache : &pDuk->cache, code, hb_parclen(iBase + 1));
+   /* 結果在執行時限內轉換, getter 和 Proxy trap 同樣受逾時約束 */
+   if (rc == 0 && !hb_duk_get_item_safe(ctx, -1, hb_stackReturnItem()))
+   {
+      duk_remove(ctx, -2);
+      rc = DUK_EXEC_ERROR;
+   }
+   hb_duk_exec_end(pDuk, &exec);
+   hb_duk_lat_record_eval(pDuk, exec.nStart, code, hb_parclen(iBase + 1));
+   if (rc != 0)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   duk_pop(ctx);
+}
+
+/* 第一個參數為 realm 句柄時返回該 realm 的編譯快取 (存放於其 global stash), 否則為 heap 的快取 */
+static HB_DUK_CACHE *hb_duk_cache_param(PHB_DUK pDuk, PHB_DUK_REALM pRealm, duk_context **pctx)
+{
+   *pctx = hb_duk_param_ctx(pDuk, pRealm);
+   if (*pctx == NULL)
+   {
+      return NULL;
+   }
+   return pRealm != NULL ? &pRealm->cache : &pDuk->cache;
+}
+
+/* 設置 DUK_EVAL 編譯快取容量 (0 表示停用), 返回原容量: DUK_EVAL_CACHE_SIZE([hHeap|hRealm,] [nSize]) */
+HB_FUNC(DUK_EVAL_CACHE_SIZE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx;
+   HB_DUK_CACHE *cache = hb_duk_cache_param(pDuk, hb_duk_realm_param(), &ctx);
+   int old;
+
+   if (cache == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   old = cache->capacity;
+   if (HB_ISNUM(iBase + 1))
+   {
+      int capacity = hb_parni(iBase + 1);
+
+      cache->capacity = capacity > 0 ? capacity : 0;
+      hb_duk_cache_reset(ctx, cache);
+   }
+   hb_retni(old);
+}
+
+/* 清空 DUK_EVAL 編譯快取: DUK_EVAL_CACHE_CLEAR([hHeap|hRealm]) */
+HB_FUNC(DUK_EVAL_CACHE_CLEAR)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx;
+   HB_DUK_CACHE *cache = hb_duk_cache_param(pDuk, hb_duk_realm_param(), &ctx);
+
+   if (cache == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_cache_reset(ctx, cache);
+   cache->hits = cache->misses = 0;
+   hb_retl(HB_TRUE);
+}
+
+/* 獲取 DUK_EVAL 編譯快取統計: DUK_EVAL_CACHE_STATS([hHeap|hRealm]) -> { 命中, 未命中, 項目數, 容量 } */
+HB_FUNC(DUK_EVAL_CACHE_STATS)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx;
+   HB_DUK_CACHE *cache = hb_duk_cache_param(pDuk, hb_duk_realm_param(), &ctx);
+   PHB_ITEM pArray;
+
+   if (cache == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pArray = hb_itemArrayNew(4);
+   hb_arraySetNInt(pArray, 1, (HB_MAXINT)cache->hits);
+   hb_arraySetNInt(pArray, 2, (HB_MAXINT)cache->misses);
+   hb_arraySetNInt(pArray, 3, cache->count);
+   hb_arraySetNInt(pArray, 4, cache->capacity);
+
+   hb_itemReturn(pArray);
+   hb_itemRelease(pArray);
+}
+
+/* 啟用或停用 DUK_EVAL_FILE 的磁碟位元組碼快取, 返回原設定 */
+HB_FUNC(DUK_BYTECODE_CACHE)
+{
+   hb_retl(s_fBytecodeCache);
+   if (HB_ISLOG(1))
+   {
+      s_fBytecodeCache = hb_parl(1);
+   }
+}
+
+/* 執行 JavaScript 文件: DUK_EVAL_FILE([hHeap,] cFile, [lCache], [nTimeoutMs]) */
+HB_FUNC(DUK_EVAL_FILE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *filename = hb_parc(iBase + 1);
+   HB_BOOL fCache = HB_ISLOG(iBase + 2) ? hb_parl(iBase + 2) : s_fBytecodeCache;
+   const char *error;
+   char *cachename = NULL;
+   HB_BOOL fLoaded = HB_FALSE;
+   HB_U64 srchash = 0;
+   HB_DUK_MAP map;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (filename == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 映射源文件, 快取以源碼雜湊驗證; 未命中時直接編譯, 不另配置緩衝區也不在 heap 中建立源碼字串 */
+   if (!hb_duk_map_open(filename, &map))
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (fCache)
+   {
+      size_t len = strlen(filename);
+
+      cachename = (char *)hb_xgrab(len + sizeof(HB_DUK_BC_EXT));
+      memcpy(cachename, filename, len);
+      memcpy(cachename + len, HB_DUK_BC_EXT, sizeof(HB_DUK_BC_EXT));
+
+      srchash = hb_duk_hash64(map.data, map.len);
+      fLoaded = hb_duk_bc_load(ctx, cachename, map.len, srchash);
+   }
+
+   if (!fLoaded)
+   {
+      duk_push_lstring(ctx, filename, hb_parclen(iBase + 1));
+      rc = duk_compile_raw(ctx, map.data, (duk_size_t)map.len,
+                           1 /* 文件名參數 */ | DUK_COMPILE_EVAL | DUK_COMPILE_SAFE | DUK_COMPILE_NOSOURCE);
+      if (rc != 0)
+      {
+         hb_duk_map_close(&map);
+         if (cachename != NULL)
+         {
+            hb_xfree(cachename);
+         }
+         error = duk_safe_to_string(ctx, -1);
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop(ctx);
+         return;
+      }
+
+      if (cachename != NULL)
+      {
+         hb_duk_bc_store(ctx, cachename, map.len, srchash);
+      }
+   }
+   hb_duk_map_close(&map);
+
+   if (cachename != NULL)
+   {
+      hb_xfree(cachename);
+   }
+
+   duk_push_global_object(ctx);
+   hb_duk_exec_begin(pDuk, pRealm, hb_parnint(iBase + 3), &exec);
+   rc = duk_pcall_method(ctx, 0);
+   hb_duk_exec_end(pDuk, &exec);
+   hb_duk_lat_record(pDuk, exec.nStart, "file:", filename, hb_parclen(iBase + 1));
+   if (rc != 0)
+   {
+      error = duk_safe_to_string(ctx, -1);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   hb_duk_retstr(ctx, -1);
+   duk_pop(ctx);
+}
+
+/* Heap 快照 (DUK_SNAPSHOT_SAVE/LOAD): 以 CBOR 編碼自全局對象可達的對象圖,
+ * 已編譯函數以 duk_dump_function 位元組碼保存. 內建對象以路徑引用, 只記錄
+ * 與全新 heap 不同的屬性. 位元組碼不含閉包的作用域, 遇到作用域不是全局環境的
+ * 函數時保存失敗, 錯誤說明列出其屬性路徑; 原生函數 (如 DUK_REGISTER_FUNCTION
+ * 註冊的) 需重新註冊 */
+#define HB_DUK_SNAP_MAGIC      "HBDUKSN1"
+#define HB_DUK_SNAP_MAX_DEPTH  1000
+#define HB_DUK_CBOR_SHAREABLE  28        /* RFC 8949 登錄的 shareable/sharedref 標籤 */
+#define HB_DUK_CBOR_SHAREDREF  29
+#define HB_DUK_CBOR_BUILTIN    27001     /* 內建對象路徑, 如 "Array.prototype.map" */
+
+/* 對象記錄種類 */
+#define HB_DUK_SNAP_OBJECT     0
+#define HB_DUK_SNAP_ARRAY      1
+#define HB_DUK_SNAP_FUNCTION   2
+#define HB_DUK_SNAP_DATE       3
+#define HB_DUK_SNAP_REGEXP     4
+#define HB_DUK_SNAP_BUFFER     5
+#define HB_DUK_SNAP_SEALED     0x10      /* 與種類合併: 對象不可擴充 */
+
+/* 屬性旗標, 低三位與 DUK_DEFPROP_WRITABLE/ENUMERABLE/CONFIGURABLE 相同 */
+#define HB_DUK_SNAP_ACCESSOR   8
+
+#define HB_DUK_SNAP_ENUM       (DUK_ENUM_OWN_PROPERTIES_ONLY | DUK_ENUM_INCLUDE_NONENUMERABLE | DUK_ENUM_NO_PROXY_BEHAVIOR)
+
+typedef struct
+{
+   char    magic[8];
+   HB_U32  version;     /* DUK_VERSION */
+   HB_U32  ptrsize;     /* 位元組碼僅適用於相同建置的引擎 */
+   HB_U64  length;      /* 之後的 CBOR 資料長度 */
+} HB_DUK_SNAP_HEADER;
+
+/* 指標 -> 編號的開放定址雜湊表 */
+typedef struct
+{
+   void   **keys;
+   int     *vals;
+   HB_SIZE  mask;
+   HB_SIZE  count;
+} HB_DUK_PTRMAP;
+
+typedef struct
+{
+   duk_context   *ref;        /* 全新的參考 heap, 用於辨識內建對象及其原始屬性 */
+   void         **pRefObj;    /* 參考 heap 中的內建對象, 以內建編號索引 */
+   void         **pBuiltin;   /* 目前 heap 中對應的對象, 未能對應時為 NULL */
+   int            iBuiltins;
+   int            iBuiltinMax;
+   HB_DUK_PTRMAP  builtins;   /* 目前 heap 對象 -> 內建編號 */
+   HB_DUK_PTRMAP  shared;     /* 已編碼對象 -> 共享編號 */
+   int            iShared;
+   void          *pToString;  /* Object.prototype.toString, 用於辨識 Date/RegExp */
+   void          *pGetTime;   /* Date.prototype.getTime */
+   void          *pExtensible;   /* Object.isExtensible */
+   char          *buf;
+   HB_SIZE        len;
+   HB_SIZE        size;
+   char          *path;       /* 目前編碼中的屬性路徑, 用於錯誤說明 */
+   HB_SIZE        pathLen;
+   HB_SIZE        pathSize;
+   char          *szError;    /* 保存失敗時的錯誤訊息 */
+} HB_DUK_SNAP;
+
+typedef struct
+{
+   const HB_UCHAR *p;
+   const HB_UCHAR *end;
+   duk_idx_t       iShared;   /* 共享對象陣列在堆疊中的位置 */
+   duk_uarridx_t   nShared;
+} HB_DUK_UNSNAP;
+
+static void hb_duk_ptrmap_init(HB_DUK_PTRMAP *m, HB_SIZE size)
+{
+   m->mask = size - 1;
+   m->count = 0;
+   m->keys = (void **)hb_xgrab(sizeof(void *) * size);
+   m->vals = (int *)hb_xgrab(sizeof(int) * size);
+   memset(m->keys, 0, sizeof(void *) * size);
+}
+
+static void hb_duk_ptrmap_free(HB_DUK_PTRMAP *m)
+{
+   if (m->keys != NULL)
+   {
+      hb_xfree(m->keys);
+      hb_xfree(m->vals);
+      m->keys = NULL;
+      m->vals = NULL;
+   }
+}
+
+static HB_SIZE hb_duk_ptrmap_slot(HB_DUK_PTRMAP *m, void *key)
+{
+   HB_SIZE i = (HB_SIZE)((((HB_PTRUINT)key) >> 3) * 2654435761U) & m->mask;
+
+   while (m->keys[i] != NULL && m->keys[i] != key)
+   {
+      i = (i + 1) & m->mask;
+   }
+   return i;
+}
+
+static int hb_duk_ptrmap_get(HB_DUK_PTRMAP *m, void *key)
+{
+   HB_SIZE i = hb_duk_ptrmap_slot(m, key);
+
+   return m->keys[i] != NULL ? m->vals[i] : -1;
+}
+
+static void hb_duk_ptrmap_put(HB_DUK_PTRMAP *m, void *key, int val)
+{
+   HB_SIZE i;
+
+   if ((m->count + 1) * 2 > m->mask + 1)
+   {
+      HB_DUK_PTRMAP old = *m;
+
+      hb_duk_ptrmap_init(m, (old.mask + 1) * 2);
+      for (i = 0; i <= old.mask; i++)
+      {
+         if (old.keys[i] != NULL)
+         {
+            HB_SIZE j = hb_duk_ptrmap_slot(m, old.keys[i]);
+
+            m->keys[j] = old.keys[i];
+            m->vals[j] = old.vals[i];
+            m->count++;
+         }
+      }
+      hb_duk_ptrmap_free(&old);
+   }
+
+   i = hb_duk_ptrmap_slot(m, key);
+   if (m->keys[i] == NULL)
+   {
+      m->keys[i] = key;
+      m->count++;
+   }
+   m->vals[i] = val;
+}
+
+/* CBOR 輸出 */
+static void hb_duk_cbor_reserve(HB_DUK_SNAP *snap, HB_SIZE n)
+{
+   if (snap->len + n > snap->size)
+   {
+      snap->size = (snap->len + n) * 2 + 4096;
+      snap->buf = (char *)hb_xrealloc(snap->buf, snap->size);
+   }
+}
+
+static void hb_duk_cbor_byte(HB_DUK_SNAP *snap, HB_UCHAR b)
+{
+   hb_duk_cbor_reserve(snap, 1);
+   snap->buf[snap->len++] = (char)b;
+}
+
+static void hb_duk_cbor_head(HB_DUK_SNAP *snap, int major, HB_U64 val)
+{
+   HB_UCHAR *p;
+   int n, i;
+
+   hb_duk_cbor_reserve(snap, 9);
+   p = (HB_UCHAR *)snap->buf + snap->len;
+   if (val < 24)
+   {
+      p[0] = (HB_UCHAR)((major << 5) | (int)val);
+      snap->len++;
+      return;
+   }
+   n = val <= 0xFF ? 1 : val <= 0xFFFF ? 2 : val <= 0xFFFFFFFFU ? 4 : 8;
+   p[0] = (HB_UCHAR)((major << 5) | (n == 1 ? 24 : n == 2 ? 25 : n == 4 ? 26 : 27));
+   for (i = n; i > 0; i--)
+   {
+      p[i] = (HB_UCHAR)val;
+      val >>= 8;
+   }
+   snap->len += n + 1;
+}
+
+static void hb_duk_cbor_data(HB_DUK_SNAP *snap, int major, const void *data, HB_SIZE len)
+{
+   hb_duk_cbor_head(snap, major, (HB_U64)len);
+   if (len > 0)
+   {
+      hb_duk_cbor_reserve(snap, len);
+      memcpy(snap->buf + snap->len, data, len);
+      snap->len += len;
+   }
+}
+
+static void hb_duk_cbor_double(HB_DUK_SNAP *snap, double d)
+{
+   HB_U64 bits;
+   HB_UCHAR *p;
+   int i;
+
+   memcpy(&bits, &d, sizeof(bits));
+   hb_duk_cbor_reserve(snap, 9);
+   p = (HB_UCHAR *)snap->buf + snap->len;
+   p[0] = 0xFB;
+   for (i = 8; i > 0; i--)
+   {
+      p[i] = (HB_UCHAR)bits;
+      bits >>= 8;
+   }
+   snap->len += 9;
+}
+
+/* 在參考 heap 推入 "id/key[suffix]", 用於查詢內建屬性的原始值 */
+static void hb_duk_snap_refkey(duk_context *r, int id, const char *key, duk_size_t klen, const char *suffix)
+{
+   duk_push_sprintf(r, "%d/", id);
+   duk_push_lstring(r, key, klen);
+   if (suffix != NULL)
+   {
+      duk_push_string(r, suffix);
+      duk_concat(r, 3);
+   }
+   else
+   {
+      duk_concat(r, 2);
+   }
+}
+
+/* 由屬性描述符取得旗標 */
+static int hb_duk_snap_desc_flags(duk_context *c, duk_idx_t didx)
+{
+   int iFlags = 0;
+
+   didx = duk_normalize_index(c, didx);
+   duk_get_prop_string(c, didx, "writable");
+   iFlags |= duk_to_boolean(c, -1) ? DUK_DEFPROP_WRITABLE : 0;
+   duk_get_prop_string(c, didx, "enumerable");
+   iFlags |= duk_to_boolean(c, -1) ? DUK_DEFPROP_ENUMERABLE : 0;
+   duk_get_prop_string(c, didx, "configurable");
+   iFlags |= duk_to_boolean(c, -1) ? DUK_DEFPROP_CONFIGURABLE : 0;
+   duk_pop_3(c);
+   if (duk_has_prop_string(c, didx, "get"))
+   {
+      iFlags |= HB_DUK_SNAP_ACCESSOR;
+   }
+   return iFlags;
+}
+
+static int hb_duk_snap_kind(duk_context *c, duk_idx_t idx)
+{
+   return duk_is_c_function(c, idx) ? 1 : duk_is_function(c, idx) ? 2 : 0;
+}
+
+/* 依 "A.b.c@get" 形式的路徑取得對象 (不觸發 getter), 成功時推入對象 */
+static HB_BOOL hb_duk_snap_resolve(duk_context *c, const char *path, duk_size_t len)
+{
+   duk_size_t start = 0;
+
+   duk_push_global_object(c);
+   while (start < len)
+   {
+      duk_size_t end = start;
+      const char *field = "value";
+
+      while (end < len && path[end] != '.')
+      {
+         end++;
+      }
+      if (end - start > 4 && path[end - 4] == '@')
+      {
+         field = memcmp(path + end - 3, "get", 3) == 0 ? "get" : "set";
+         duk_push_lstring(c, path + start, end - start - 4);
+      }
+      else
+      {
+         duk_push_lstring(c, path + start, end - start);
+      }
+      duk_get_prop_desc(c, -2, 0);
+      if (!duk_is_object(c, -1))
+      {
+         duk_pop_2(c);
+         return HB_FALSE;
+      }
+      duk_get_prop_string(c, -1, field);
+      duk_remove(c, -2);
+      duk_remove(c, -2);
+      if (!duk_is_object(c, -1))
+      {
+         duk_pop(c);
+         return HB_FALSE;
+      }
+      start = end + 1;
+   }
+   return HB_TRUE;
+}
+
+/* 參考 heap 中首次遇到的對象登記為內建對象, 返回編號; 無法以路徑表示時返回 -1 */
+static int hb_duk_snap_visit(HB_DUK_SNAP *snap, HB_DUK_PTRMAP *seen, duk_idx_t vidx, int parent, duk_idx_t kidx, const char *suffix)
+{
+   duk_context *r = snap->ref;
+   void *ptr = duk_get_heapptr(r, vidx);
+   int id = hb_duk_ptrmap_get(seen, ptr);
+   duk_size_t klen, plen;
+   const char *key;
+
+   if (id >= 0)
+   {
+      return id;
+   }
+   key = duk_get_lstring(r, kidx, &klen);
+   if (klen == 0 || memchr(key, '.', klen) != NULL || memchr(key, '@', klen) != NULL)
+   {
+      return -1;
+   }
+
+   if (snap->iBuiltins >= snap->iBuiltinMax)
+   {
+      snap->iBuiltinMax *= 2;
+      snap->pRefObj = (void **)hb_xrealloc(snap->pRefObj, sizeof(void *) * snap->iBuiltinMax);
+   }
+   id = snap->iBuiltins++;
+   snap->pRefObj[id] = ptr;
+   hb_duk_ptrmap_put(seen, ptr, id);
+
+   /* paths[id] = paths[parent] + "." + key + suffix */
+   duk_get_prop_index(r, 0, (duk_uarridx_t)parent);
+   duk_get_lstring(r, -1, &plen);
+   if (plen > 0)
+   {
+      duk_push_string(r, ".");
+   }
+   duk_dup(r, kidx);
+   if (suffix != NULL)
+   {
+      duk_push_string(r, suffix);
+   }
+   duk_concat(r, 2 + (plen > 0 ? 1 : 0) + (suffix != NULL ? 1 : 0));
+   duk_put_prop_index(r, 0, (duk_uarridx_t)id);
+
+   duk_push_int(r, hb_duk_snap_kind(r, vidx));
+   duk_put_prop_index(r, 5, (duk_uarridx_t)id);
+   return id;
+}
+
+/* 在參考 heap 中廣度優先遍歷內建對象圖. 堆疊: 0 paths, 1 objs (id/key -> 子對象編號),
+ * 2 prims (id/key -> 原始值), 3 flags (id/key -> 旗標), 4 keys (id -> 屬性名陣列), 5 kinds */
+static void hb_duk_snap_scan(HB_DUK_SNAP *snap)
+{
+   duk_context *r = snap->ref;
+   HB_DUK_PTRMAP seen;
+   int i;
+
+   duk_push_array(r);
+   duk_push_object(r);
+   duk_push_object(r);
+   duk_push_object(r);
+   duk_push_array(r);
+   duk_push_array(r);
+
+   snap->iBuiltinMax = 256;
+   snap->pRefObj = (void **)hb_xgrab(sizeof(void *) * snap->iBuiltinMax);
+   hb_duk_ptrmap_init(&seen, 1024);
+
+   duk_push_global_object(r);
+   snap->pRefObj[0] = duk_get_heapptr(r, -1);
+   snap->iBuiltins = 1;
+   hb_duk_ptrmap_put(&seen, snap->pRefObj[0], 0);
+   duk_pop(r);
+   duk_push_string(r, "");
+   duk_put_prop_index(r, 0, 0);
+   duk_push_int(r, 0);
+   duk_put_prop_index(r, 5, 0);
+
+   for (i = 0; i < snap->iBuiltins; i++)
+   {
+      duk_uarridx_t k = 0;
+
+      duk_push_heapptr(r, snap->pRefObj[i]);   /* 6 */
+      duk_push_array(r);                        /* 7: 屬性名 */
+      duk_enum(r, 6, HB_DUK_SNAP_ENUM);         /* 8 */
+      while (duk_next(r, 8, 0))                 /* 9: key */
+      {
+         duk_size_t klen;
+         const char *key = duk_get_lstring(r, 9, &klen);
+         int iFlags;
+
+         duk_dup(r, 9);
+         duk_put_prop_index(r, 7, k++);
+         duk_dup(r, 9);
+         duk_get_prop_desc(r, 6, 0);            /* 10: desc */
+         iFlags = hb_duk_snap_desc_flags(r, 10);
+
+         hb_duk_snap_refkey(r, i, key, klen, NULL);   /* 11 */
+         duk_dup(r, 11);
+         duk_push_int(r, iFlags);
+         duk_put_prop(r, 3);
+
+         if (iFlags & HB_DUK_SNAP_ACCESSOR)
+         {
+            static const char *s_szFields[2] = { "get", "set" };
+            int n;
+
+            for (n = 0; n < 2; n++)
+            {
+               int child = -1;
+
+               duk_get_prop_string(r, 10, s_szFields[n]);   /* 12 */
+               if (duk_is_object(r, 12))
+               {
+                  child = hb_duk_snap_visit(snap, &seen, 12, i, 9, n == 0 ? "@get" : "@set");
+               }
+               hb_duk_snap_refkey(r, i, key, klen, n == 0 ? "@get" : "@set");
+               duk_push_int(r, child);
+               duk_put_prop(r, 1);
+               duk_pop(r);
+            }
+         }
+         else
+         {
+            duk_get_prop_string(r, 10, "value");   /* 12 */
+            if (duk_is_object(r, 12))
+            {
+               int child = hb_duk_snap_visit(snap, &seen, 12, i, 9, NULL);
+
+               if (child >= 0)
+               {
+                  duk_dup(r, 11);
+                  duk_push_int(r, child);
+                  duk_put_prop(r, 1);
+               }
+            }
+            else
+            {
+               duk_dup(r, 11);
+               duk_dup(r, 12);
+               duk_put_prop(r, 2);
+            }
+         }
+         duk_set_top(r, 9);
+      }
+      duk_pop(r);
+      duk_put_prop_index(r, 4, (duk_uarridx_t)i);
+      duk_pop(r);
+   }
+
+   hb_duk_ptrmap_free(&seen);
+}
+
+/* 在目前 heap 中找出與參考 heap 相同路徑且種類相同的內建對象 */
+static void hb_duk_snap_bind(duk_context *c, HB_DUK_SNAP *snap)
+{
+   duk_context *r = snap->ref;
+   int i;
+
+   snap->pBuiltin = (void **)hb_xgrab(sizeof(void *) * snap->iBuiltins);
+   hb_duk_ptrmap_init(&snap->builtins, 1024);
+   for (i = 0; i < snap->iBuiltins; i++)
+   {
+      duk_size_t plen;
+      const char *path;
+
+      snap->pBuiltin[i] = NULL;
+      duk_get_prop_index(r, 0, (duk_uarridx_t)i);
+      path = duk_get_lstring(r, -1, &plen);
+      if (hb_duk_snap_resolve(c, path, plen))
+      {
+         void *ptr = duk_get_heapptr(c, -1);
+
+         duk_get_prop_index(r, 5, (duk_uarridx_t)i);
+         if (duk_get_int(r, -1) == hb_duk_snap_kind(c, -1) && hb_duk_ptrmap_get(&snap->builtins, ptr) < 0)
+         {
+            snap->pBuiltin[i] = ptr;
+            hb_duk_ptrmap_put(&snap->builtins, ptr, i);
+         }
+         duk_pop(r);
+         duk_pop(c);
+      }
+      duk_pop(r);
+   }
+
+   if (hb_duk_snap_resolve(c, "Object.prototype.toString", 25))
+   {
+      snap->pToString = duk_get_heapptr(c, -1);
+      duk_pop(c);
+   }
+   if (hb_duk_snap_resolve(c, "Date.prototype.getTime", 22))
+   {
+      snap->pGetTime = duk_get_heapptr(c, -1);
+      duk_pop(c);
+   }
+   if (hb_duk_snap_resolve(c, "Object.isExtensible", 19))
+   {
+      snap->pExtensible = duk_get_heapptr(c, -1);
+      duk_pop(c);
+   }
+}
+
+/* 比較目前 heap 與參考 heap 的原始值 */
+static HB_BOOL hb_duk_snap_prim_equal(duk_context *c, duk_idx_t ci, duk_context *r, duk_idx_t ri)
+{
+   int iType = duk_get_type(c, ci);
+
+   if (iType != duk_get_type(r, ri))
+   {
+      return HB_FALSE;
+   }
+   switch (iType)
+   {
+      case DUK_TYPE_UNDEFINED:
+      case DUK_TYPE_NULL:
+         return HB_TRUE;
+
+      case DUK_TYPE_BOOLEAN:
+         return (duk_get_boolean(c, ci) != 0) == (duk_get_boolean(r, ri) != 0);
+
+      case DUK_TYPE_NUMBER:
+      {
+         double a = duk_get_number(c, ci), b = duk_get_number(r, ri);
+
+         return memcmp(&a, &b, sizeof(double)) == 0 || (a != a && b != b);
+      }
+
+      case DUK_TYPE_STRING:
+      {
+         duk_size_t alen, blen;
+         const char *a = duk_get_lstring(c, ci, &alen);
+         const char *b = duk_get_lstring(r, ri, &blen);
+
+         return alen == blen && memcmp(a, b, alen) == 0;
+      }
+   }
+   return HB_FALSE;
+}
+
+/* 目前 heap 堆疊 vidx 的值是否為參考 heap 中 id/key[suffix] 所指的同一內建對象 */
+static HB_BOOL hb_duk_snap_same_ref(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t vidx, int id, const char *key, duk_size_t klen, const char *suffix)
+{
+   duk_context *r = snap->ref;
+   int child = duk_is_object(c, vidx) ? hb_duk_ptrmap_get(&snap->builtins, duk_get_heapptr(c, vidx)) : -1;
+   HB_BOOL fSame;
+
+   if (child < 0 && duk_is_object(c, vidx))
+   {
+      return HB_FALSE;
+   }
+   hb_duk_snap_refkey(r, id, key, klen, suffix);
+   fSame = duk_get_prop(r, 1) && duk_get_int(r, -1) == child;
+   duk_pop(r);
+   return fSame;
+}
+
+/* 內建對象的屬性是否與全新 heap 相同 */
+static HB_BOOL hb_duk_snap_unchanged(duk_context *c, HB_DUK_SNAP *snap, int id, const char *key, duk_size_t klen, duk_idx_t didx, int iFlags)
+{
+   duk_context *r = snap->ref;
+   duk_idx_t top = duk_get_top(r);
+   HB_BOOL fSame = HB_FALSE;
+
+   didx = duk_normalize_index(c, didx);
+   hb_duk_snap_refkey(r, id, key, klen, NULL);
+   duk_dup_top(r);
+   if (duk_get_prop(r, 3) && duk_get_int(r, -1) == iFlags)
+   {
+      if (iFlags & HB_DUK_SNAP_ACCESSOR)
+      {
+         duk_get_prop_string(c, didx, "get");
+         duk_get_prop_string(c, didx, "set");
+         fSame = hb_duk_snap_same_ref(c, snap, -2, id, key, klen, "@get") &&
+                 hb_duk_snap_same_ref(c, snap, -1, id, key, klen, "@set");
+         duk_pop_2(c);
+      }
+      else
+      {
+         duk_get_prop_string(c, didx, "value");
+         if (duk_is_object(c, -1))
+         {
+            fSame = hb_duk_snap_same_ref(c, snap, -1, id, key, klen, NULL);
+         }
+         else
+         {
+            duk_dup(r, top);
+            fSame = duk_get_prop(r, 2) && hb_duk_snap_prim_equal(c, -1, r, -1);
+         }
+         duk_pop(c);
+      }
+   }
+   duk_set_top(r, top);
+   return fSame;
+}
+
+/* 無法保存的值: 原生或綁定函數 (非內建), 執行緒, Symbol */
+static HB_BOOL hb_duk_snap_skip(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx)
+{
+   if (duk_is_symbol(c, idx) || duk_is_lightfunc(c, idx))
+   {
+      return HB_TRUE;
+   }
+   if (duk_is_object(c, idx) && hb_duk_ptrmap_get(&snap->builtins, duk_get_heapptr(c, idx)) < 0)
+   {
+      return duk_is_thread(c, idx) ||
+             (duk_is_function(c, idx) && (!duk_is_ecmascript_function(c, idx) || duk_is_bound_function(c, idx)));
+   }
+   return HB_FALSE;
+}
+
+static void hb_duk_snap_value(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx, int iDepth);
+
+/* 在屬性路徑後加上 ".key", 返回原長度供還原 */
+static HB_SIZE hb_duk_snap_path_push(HB_DUK_SNAP *snap, const char *key, HB_SIZE klen)
+{
+   HB_SIZE nMark = snap->pathLen;
+
+   if (snap->pathLen + klen + 2 > snap->pathSize)
+   {
+      snap->pathSize = (snap->pathLen + klen + 2) * 2 + 64;
+      snap->path = (char *)hb_xrealloc(snap->path, snap->pathSize);
+   }
+   if (snap->pathLen > 0)
+   {
+      snap->path[snap->pathLen++] = '.';
+   }
+   memcpy(snap->path + snap->pathLen, key, klen);
+   snap->pathLen += klen;
+   return nMark;
+}
+
+/* 編碼對象自身屬性 (含不可列舉者). 內建對象 (id >= 0) 只記錄變更及刪除的屬性. 返回項目數 */
+static int hb_duk_snap_props(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx, int iKind, int id, int iDepth)
+{
+   int iCount = 0;
+   HB_SIZE nMark;
+
+   idx = duk_normalize_index(c, idx);
+   hb_duk_cbor_byte(snap, 0x9F);
+   if (iKind != HB_DUK_SNAP_BUFFER)   /* 緩衝區對象的索引屬性是虛擬的, 不需列舉 */
+   {
+      duk_enum(c, idx, HB_DUK_SNAP_ENUM);
+      while (duk_next(c, -1, 0))
+      {
+         duk_size_t klen;
+         const char *key = duk_get_lstring(c, -1, &klen);
+         int iFlags;
+
+         if ((iKind == HB_DUK_SNAP_ARRAY && klen == 6 && memcmp(key, "length", 6) == 0) ||
+             (iKind == HB_DUK_SNAP_FUNCTION && ((klen == 6 && memcmp(key, "length", 6) == 0) ||
+                                                (klen == 4 && memcmp(key, "name", 4) == 0) ||
+                                                (klen == 8 && memcmp(key, "fileName", 8) == 0))))
+         {
+            duk_pop(c);
+            continue;
+         }
+
+         duk_dup_top(c);
+         duk_get_prop_desc(c, idx, 0);   /* [ ... enum key desc ] */
+         iFlags = hb_duk_snap_desc_flags(c, -1);
+         if (id >= 0 && hb_duk_snap_unchanged(c, snap, id, key, klen, -1, iFlags))
+         {
+            duk_pop_2(c);
+            continue;
+         }
+
+         nMark = hb_duk_snap_path_push(snap, key, (HB_SIZE)klen);
+         if (iFlags & HB_DUK_SNAP_ACCESSOR)
+         {
+            duk_get_prop_string(c, -1, "get");
+            duk_get_prop_string(c, -2, "set");
+            hb_duk_cbor_head(snap, 4, 4);
+            hb_duk_cbor_data(snap, 3, key, (HB_SIZE)klen);
+            hb_duk_snap_value(c, snap, -2, iDepth);
+            hb_duk_snap_value(c, snap, -1, iDepth);
+            hb_duk_cbor_head(snap, 0, (HB_U64)(iFlags & DUK_DEFPROP_WEC));
+            duk_pop_2(c);
+            iCount++;
+         }
+         else
+         {
+            duk_get_prop_string(c, -1, "value");
+            if (!hb_duk_snap_skip(c, snap, -1))
+            {
+               hb_duk_cbor_head(snap, 4, 3);
+               hb_duk_cbor_data(snap, 3, key, (HB_SIZE)klen);
+               hb_duk_snap_value(c, snap, -1, iDepth);
+               hb_duk_cbor_head(snap, 0, (HB_U64)(iFlags & DUK_DEFPROP_WEC));
+               iCount++;
+            }
+            duk_pop(c);
+         }
+         snap->pathLen = nMark;
+         duk_pop_2(c);
+      }
+      duk_pop(c);
+   }
+
+   if (id >= 0)
+   {
+      duk_context *r = snap->ref;
+      duk_size_t n, nLen;
+
+      /* 全新 heap 中存在但已被刪除的屬性 */
+      duk_get_prop_index(r, 4, (duk_uarridx_t)id);
+      nLen = duk_get_length(r, -1);
+      for (n = 0; n < nLen; n++)
+      {
+         duk_size_t klen;
+         const char *key;
+
+         duk_get_prop_index(r, -1, (duk_uarridx_t)n);
+         key = duk_get_lstring(r, -1, &klen);
+         duk_push_lstring(c, key, klen);
+         duk_get_prop_desc(c, idx, 0);
+         if (duk_is_undefined(c, -1))
+         {
+            hb_duk_cbor_head(snap, 4, 1);
+            hb_duk_cbor_data(snap, 3, key, (HB_SIZE)klen);
+            iCount++;
+         }
+         duk_pop(c);
+         duk_pop(r);
+      }
+      duk_pop(r);
+   }
+
+   hb_duk_cbor_byte(snap, 0xFF);
+   return iCount;
+}
+
+/* 以 Object.prototype.toString 判斷對象類別 */
+static HB_BOOL hb_duk_snap_is_class(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx, const char *szClass)
+{
+   HB_BOOL fResult;
+
+   if (snap->pToString == NULL)
+   {
+      return HB_FALSE;
+   }
+   duk_push_heapptr(c, snap->pToString);
+   duk_dup(c, idx);
+   duk_call_method(c, 0);
+   fResult = strcmp(duk_get_string(c, -1), szClass) == 0;
+   duk_pop(c);
+   return fResult;
+}
+
+static void hb_duk_snap_object(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx, int iDepth)
+{
+   void *ptr = duk_get_heapptr(c, idx);
+   int n = hb_duk_ptrmap_get(&snap->shared, ptr);
+   int id, iKind, iSealed;
+
+   if (n >= 0)
+   {
+      hb_duk_cbor_head(snap, 6, HB_DUK_CBOR_SHAREDREF);
+      hb_duk_cbor_head(snap, 0, (HB_U64)n);
+      return;
+   }
+
+   hb_duk_ptrmap_put(&snap->shared, ptr, snap->iShared++);
+   hb_duk_cbor_head(snap, 6, HB_DUK_CBOR_SHAREABLE);
+
+   id = hb_duk_ptrmap_get(&snap->builtins, ptr);
+   if (id >= 0)
+   {
+      duk_size_t plen;
+      const char *path;
+
+      duk_get_prop_index(snap->ref, 0, (duk_uarridx_t)id);
+      path = duk_get_lstring(snap->ref, -1, &plen);
+      hb_duk_cbor_head(snap, 6, HB_DUK_CBOR_BUILTIN);
+      hb_duk_cbor_data(snap, 3, path, (HB_SIZE)plen);
+      duk_pop(snap->ref);
+      return;
+   }
+
+   if (iDepth >= HB_DUK_SNAP_MAX_DEPTH)
+   {
+      (void)duk_range_error(c, "snapshot: object graph too deep");
+   }
+   duk_require_stack(c, 16);
+   idx = duk_normalize_index(c, idx);
+
+   iSealed = 0;
+   if (snap->pExtensible != NULL)
+   {
+      duk_push_heapptr(c, snap->pExtensible);
+      duk_dup(c, idx);
+      duk_call(c, 1);
+      iSealed = duk_to_boolean(c, -1) ? 0 : HB_DUK_SNAP_SEALED;
+      duk_pop(c);
+   }
+
+   if (duk_is_function(c, idx))
+   {
+      duk_size_t len;
+      void *data;
+
+      /* 閉包還原後會失去捕獲的變量, 直到呼叫時才出錯; 不如在保存時拒絕 */
+      if (duk_hb_push_scope_records(c, idx) > 0)
+      {
+         (void)duk_type_error(c, "snapshot: closure cannot be saved: %.*s", (int)snap->pathLen, snap->path);
+      }
+
+      iKind = HB_DUK_SNAP_FUNCTION;
+      hb_duk_cbor_head(snap, 4, 4);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+      duk_dup(c, idx);
+      duk_dump_function(c);
+      data = duk_get_buffer(c, -1, &len);
+      hb_duk_cbor_data(snap, 2, data, (HB_SIZE)len);
+      duk_pop(c);
+   }
+   else if (duk_is_array(c, idx))
+   {
+      iKind = HB_DUK_SNAP_ARRAY;
+      hb_duk_cbor_head(snap, 4, 4);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+      hb_duk_cbor_head(snap, 0, (HB_U64)duk_get_length(c, idx));
+   }
+   else if (duk_is_buffer_data(c, idx))
+   {
+      duk_size_t len;
+      void *data = duk_get_buffer_data(c, idx, &len);
+
+      iKind = HB_DUK_SNAP_BUFFER;
+      hb_duk_cbor_head(snap, 4, 4);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+      hb_duk_cbor_data(snap, 2, data, (HB_SIZE)len);
+   }
+   else if (snap->pGetTime != NULL && hb_duk_snap_is_class(c, snap, idx, "[object Date]"))
+   {
+      iKind = HB_DUK_SNAP_DATE;
+      hb_duk_cbor_head(snap, 4, 4);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+      duk_push_heapptr(c, snap->pGetTime);
+      duk_dup(c, idx);
+      duk_call_method(c, 0);
+      hb_duk_cbor_double(snap, duk_get_number(c, -1));
+      duk_pop(c);
+   }
+   else if (hb_duk_snap_is_class(c, snap, idx, "[object RegExp]"))
+   {
+      char flags[4];
+      int n = 0;
+
+      iKind = HB_DUK_SNAP_REGEXP;
+      hb_duk_cbor_head(snap, 4, 5);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+      duk_get_prop_string(c, idx, "source");
+      hb_duk_snap_value(c, snap, -1, iDepth + 1);
+      duk_get_prop_string(c, idx, "global");
+      duk_get_prop_string(c, idx, "ignoreCase");
+      duk_get_prop_string(c, idx, "multiline");
+      if (duk_to_boolean(c, -3))
+         flags[n++] = 'g';
+      if (duk_to_boolean(c, -2))
+         flags[n++] = 'i';
+      if (duk_to_boolean(c, -1))
+         flags[n++] = 'm';
+      hb_duk_cbor_data(snap, 3, flags, (HB_SIZE)n);
+      duk_pop_n(c, 4);
+   }
+   else
+   {
+      iKind = HB_DUK_SNAP_OBJECT;
+      hb_duk_cbor_head(snap, 4, 3);
+      hb_duk_cbor_head(snap, 0, (HB_U64)(iKind | iSealed));
+   }
+
+   /* 沒有原型時 duk_get_prototype 推入 undefined, 以 null 保存 */
+   duk_get_prototype(c, idx);
+   if (duk_is_undefined(c, -1))
+   {
+      hb_duk_cbor_byte(snap, 0xF6);
+   }
+   else
+   {
+      HB_SIZE nMark = hb_duk_snap_path_push(snap, "__proto__", 9);
+
+      hb_duk_snap_value(c, snap, -1, iDepth + 1);
+      snap->pathLen = nMark;
+   }
+   duk_pop(c);
+   hb_duk_snap_props(c, snap, idx, iKind, -1, iDepth + 1);
+}
+
+static void hb_duk_snap_value(duk_context *c, HB_DUK_SNAP *snap, duk_idx_t idx, int iDepth)
+{
+   switch (duk_get_type(c, idx))
+   {
+      case DUK_TYPE_NULL:
+      case DUK_TYPE_POINTER:
+         hb_duk_cbor_byte(snap, 0xF6);
+         break;
+
+      case DUK_TYPE_BOOLEAN:
+         hb_duk_cbor_byte(snap, duk_get_boolean(c, idx) ? 0xF5 : 0xF4);
+         break;
+
+      case DUK_TYPE_NUMBER:
+      {
+         double d = duk_get_number(c, idx);
+
+         /* 安全整數範圍內的整數以 CBOR 整數保存, -0 保留為浮點數 */
+         if (d >= -HB_DUK_MAX_SAFE_INT && d <= HB_DUK_MAX_SAFE_INT && (double)(HB_I64)d == d &&
+             (d != 0 || 1 / d > 0))
+         {
+            HB_I64 n = (HB_I64)d;
+
+            if (n >= 0)
+               hb_duk_cbor_head(snap, 0, (HB_U64)n);
+            else
+               hb_duk_cbor_head(snap, 1, (HB_U64)(-1 - n));
+         }
+         else
+         {
+            hb_duk_cbor_double(snap, d);
+         }
+         break;
+      }
+
+      case DUK_TYPE_STRING:
+         if (duk_is_symbol(c, idx))
+         {
+            hb_duk_cbor_byte(snap, 0xF7);
+         }
+         else
+         {
+            duk_size_t len;
+            const char *str = duk_get_lstring(c, idx, &len);
+
+            hb_duk_cbor_data(snap, 3, str, (HB_SIZE)len);
+         }
+         break;
+
+      case DUK_TYPE_BUFFER:
+      {
+         duk_size_t len;
+         void *data = duk_get_buffer(c, idx, &len);
+
+         hb_duk_cbor_data(snap, 2, data, (HB_SIZE)len);
+         break;
+      }
+
+      case DUK_TYPE_OBJECT:
+         if (!hb_duk_snap_skip(c, snap, idx))
+         {
+            hb_duk_snap_object(c, snap, idx, iDepth);
+            break;
+         }
+         /* fallthrough */
+
+      default:
+         hb_duk_cbor_byte(snap, 0xF7);
+         break;
+   }
+}
+
+/* 快照主體: 依序編碼每個內建對象的屬性變更 (全局對象為第一個) */
+static duk_ret_t hb_duk_snap_save_raw(duk_context *c, void *udata)
+{
+   HB_DUK_SNAP *snap = (HB_DUK_SNAP *)udata;
+   int i;
+
+   hb_duk_snap_scan(snap);
+   hb_duk_snap_bind(c, snap);
+   hb_duk_ptrmap_init(&snap->shared, 1024);
+
+   hb_duk_cbor_byte(snap, 0x9F);
+   for (i = 0; i < snap->iBuiltins; i++)
+   {
+      if (snap->pBuiltin[i] != NULL)
+      {
+         HB_SIZE nMark = snap->len;
+         duk_size_t plen;
+         const char *path;
+
+         duk_get_prop_index(snap->ref, 0, (duk_uarridx_t)i);
+         path = duk_get_lstring(snap->ref, -1, &plen);
+         hb_duk_cbor_head(snap, 4, 2);
+         hb_duk_cbor_data(snap, 3, path, (HB_SIZE)plen);
+         snap->pathLen = 0;
+         hb_duk_snap_path_push(snap, path, (HB_SIZE)plen);
+         duk_pop(snap->ref);
+
+         duk_push_heapptr(c, snap->pBuiltin[i]);
+         if (hb_duk_snap_props(c, snap, -1, -1, i, 0) == 0)
+         {
+            snap->len = nMark;   /* 沒有變更, 撤回此項 */
+         }
+         duk_pop(c);
+      }
+   }
+   hb_duk_cbor_byte(snap, 0xFF);
+   return 0;
+}
+
+static void hb_duk_snap_release(HB_DUK_SNAP *snap)
+{
+   if (snap->ref != NULL)
+   {
+      duk_destroy_heap(snap->ref);
+   }
+   if (snap->pRefObj != NULL)
+   {
+      hb_xfree(snap->pRefObj);
+   }
+   if (snap->pBuiltin != NULL)
+   {
+      hb_xfree(snap->pBuiltin);
+   }
+   if (snap->buf != NULL)
+   {
+      hb_xfree(snap->buf);
+   }
+   if (snap->path != NULL)
+   {
+      hb_xfree(snap->path);
+   }
+   if (snap->szError != NULL)
+   {
+      hb_xfree(snap->szError);
+   }
+   hb_duk_ptrmap_free(&snap->builtins);
+   hb_duk_ptrmap_free(&snap->shared);
+}
+
+/* CBOR 輸入 */
+static void hb_duk_unsnap_corrupt(duk_context *c)
+{
+   (void)duk_generic_error(c, "snapshot: corrupt data");
+}
+
+static HB_U64 hb_duk_cbor_read(duk_context *c, HB_DUK_UNSNAP *u, int *piMajor)
+{
+   int ai, n;
+   HB_U64 val = 0;
+
+   if (u->p >= u->end)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   *piMajor = *u->p >> 5;
+   ai = *u->p++ & 0x1F;
+   if (ai < 24)
+   {
+      return (HB_U64)ai;
+   }
+   if (ai > 27)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   n = 1 << (ai - 24);
+   if (u->end - u->p < n)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   while (n-- > 0)
+   {
+      val = (val << 8) | *u->p++;
+   }
+   return val;
+}
+
+static HB_U64 hb_duk_cbor_expect(duk_context *c, HB_DUK_UNSNAP *u, int iMajor)
+{
+   int iGot;
+   HB_U64 val = hb_duk_cbor_read(c, u, &iGot);
+
+   if (iGot != iMajor)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   return val;
+}
+
+/* 讀取字串或位元組資料, 返回資料指標 */
+static const char *hb_duk_cbor_expect_data(duk_context *c, HB_DUK_UNSNAP *u, int iMajor, duk_size_t *plen)
+{
+   HB_U64 len = hb_duk_cbor_expect(c, u, iMajor);
+   const char *data = (const char *)u->p;
+
+   if (len > (HB_U64)(u->end - u->p))
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   u->p += (HB_SIZE)len;
+   *plen = (duk_size_t)len;
+   return data;
+}
+
+static void hb_duk_unsnap_value(duk_context *c, HB_DUK_UNSNAP *u, int iDepth);
+
+/* 還原屬性項目到 objidx 的對象 */
+static void hb_duk_unsnap_props(duk_context *c, HB_DUK_UNSNAP *u, duk_idx_t objidx, int iDepth)
+{
+   if (u->p >= u->end || *u->p++ != 0x9F)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   for (;;)
+   {
+      HB_U64 nItems;
+      duk_size_t klen;
+      const char *key;
+
+      if (u->p >= u->end)
+      {
+         hb_duk_unsnap_corrupt(c);
+      }
+      if (*u->p == 0xFF)
+      {
+         u->p++;
+         break;
+      }
+      nItems = hb_duk_cbor_expect(c, u, 4);
+      key = hb_duk_cbor_expect_data(c, u, 3, &klen);
+      duk_push_lstring(c, key, klen);
+      if (nItems == 1)
+      {
+         duk_del_prop(c, objidx);
+      }
+      else if (nItems == 3)
+      {
+         hb_duk_unsnap_value(c, u, iDepth);
+         duk_def_prop(c, objidx, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_HAVE_WEC | DUK_DEFPROP_FORCE |
+                      ((duk_uint_t)hb_duk_cbor_expect(c, u, 0) & DUK_DEFPROP_WEC));
+      }
+      else if (nItems == 4)
+      {
+         hb_duk_unsnap_value(c, u, iDepth);
+         hb_duk_unsnap_value(c, u, iDepth);
+         duk_def_prop(c, objidx, DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER | DUK_DEFPROP_HAVE_EC | DUK_DEFPROP_FORCE |
+                      ((duk_uint_t)hb_duk_cbor_expect(c, u, 0) & DUK_DEFPROP_EC));
+      }
+      else
+      {
+         hb_duk_unsnap_corrupt(c);
+      }
+   }
+}
+
+/* 還原共享編號 n 的對象 (內建路徑或對象記錄) */
+static void hb_duk_unsnap_object(duk_context *c, HB_DUK_UNSNAP *u, duk_uarridx_t n, int iDepth)
+{
+   HB_U64 nItems, nLength = 0;
+   duk_idx_t objidx;
+   duk_size_t len;
+   const char *data;
+   int iMajor, iKind, iSealed;
+
+   if (iDepth >= HB_DUK_SNAP_MAX_DEPTH)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   duk_require_stack(c, 16);
+
+   nItems = hb_duk_cbor_read(c, u, &iMajor);
+   if (iMajor == 6)
+   {
+      if (nItems != HB_DUK_CBOR_BUILTIN)
+      {
+         hb_duk_unsnap_corrupt(c);
+      }
+      data = hb_duk_cbor_expect_data(c, u, 3, &len);
+      if (!hb_duk_snap_resolve(c, data, len))
+      {
+         (void)duk_generic_error(c, "snapshot: builtin not found: %.*s", (int)len, data);
+      }
+      duk_dup_top(c);
+      duk_put_prop_index(c, u->iShared, n);
+      return;
+   }
+   if (iMajor != 4 || nItems < 3)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+
+   iKind = (int)hb_duk_cbor_expect(c, u, 0);
+   iSealed = iKind & HB_DUK_SNAP_SEALED;
+   iKind &= ~HB_DUK_SNAP_SEALED;
+   switch (iKind)
+   {
+      case HB_DUK_SNAP_OBJECT:
+         duk_push_object(c);
+         break;
+
+      case HB_DUK_SNAP_ARRAY:
+         nLength = hb_duk_cbor_expect(c, u, 0);
+         duk_push_array(c);
+         break;
+
+      case HB_DUK_SNAP_FUNCTION:
+         data = hb_duk_cbor_expect_data(c, u, 2, &len);
+         duk_push_external_buffer(c);
+         duk_config_buffer(c, -1, (void *)data, len);
+         duk_load_function(c);
+         break;
+
+      case HB_DUK_SNAP_DATE:
+         duk_get_global_string(c, "Date");
+         hb_duk_unsnap_value(c, u, iDepth + 1);
+         duk_new(c, 1);
+         break;
+
+      case HB_DUK_SNAP_REGEXP:
+         duk_get_global_string(c, "RegExp");
+         hb_duk_unsnap_value(c, u, iDepth + 1);
+         hb_duk_unsnap_value(c, u, iDepth + 1);
+         duk_new(c, 2);
+         break;
+
+      case HB_DUK_SNAP_BUFFER:
+         data = hb_duk_cbor_expect_data(c, u, 2, &len);
+         memcpy(duk_push_fixed_buffer(c, len), data, len);
+         duk_push_buffer_object(c, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+         duk_remove(c, -2);
+         break;
+
+      default:
+         hb_duk_unsnap_corrupt(c);
+   }
+   objidx = duk_get_top_index(c);
+   duk_dup(c, objidx);
+   duk_put_prop_index(c, u->iShared, n);
+
+   /* 原型: null 表示沒有原型 (duk_set_prototype 以 undefined 表示) */
+   hb_duk_unsnap_value(c, u, iDepth + 1);
+   if (duk_is_null(c, -1))
+   {
+      duk_pop(c);
+      duk_push_undefined(c);
+   }
+   if (duk_is_object(c, -1) || duk_is_undefined(c, -1))
+   {
+      duk_set_prototype(c, objidx);
+   }
+   else
+   {
+      duk_pop(c);
+   }
+   hb_duk_unsnap_props(c, u, objidx, iDepth + 1);
+
+   if (iKind == HB_DUK_SNAP_ARRAY)
+   {
+      duk_push_number(c, (duk_double_t)nLength);
+      duk_put_prop_string(c, objidx, "length");
+   }
+   if (iSealed && hb_duk_snap_resolve(c, "Object.preventExtensions", 24))
+   {
+      duk_dup(c, objidx);
+      duk_call(c, 1);
+      duk_pop(c);
+   }
+}
+
+static void hb_duk_unsnap_value(duk_context *c, HB_DUK_UNSNAP *u, int iDepth)
+{
+   HB_U64 val;
+   int iMajor;
+
+   if (u->p >= u->end)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   if ((*u->p >> 5) == 7)
+   {
+      switch (*u->p++)
+      {
+         case 0xF4:
+            duk_push_false(c);
+            return;
+         case 0xF5:
+            duk_push_true(c);
+            return;
+         case 0xF6:
+            duk_push_null(c);
+            return;
+         case 0xF7:
+            duk_push_undefined(c);
+            return;
+         case 0xFB:
+         {
+            HB_U64 bits = 0;
+            double d;
+            int i;
+
+            if (u->end - u->p < 8)
+            {
+               hb_duk_unsnap_corrupt(c);
+            }
+            for (i = 0; i < 8; i++)
+            {
+               bits = (bits << 8) | *u->p++;
+            }
+            memcpy(&d, &bits, sizeof(d));
+            duk_push_number(c, d);
+            return;
+         }
+      }
+      hb_duk_unsnap_corrupt(c);
+   }
+
+   val = hb_duk_cbor_read(c, u, &iMajor);
+   switch (iMajor)
+   {
+      case 0:
+         duk_push_number(c, (duk_double_t)val);
+         break;
+
+      case 1:
+         duk_push_number(c, -1.0 - (duk_double_t)val);
+         break;
+
+      case 2:
+      case 3:
+         if (val > (HB_U64)(u->end - u->p))
+         {
+            hb_duk_unsnap_corrupt(c);
+         }
+         if (iMajor == 2)
+         {
+            memcpy(duk_push_fixed_buffer(c, (duk_size_t)val), u->p, (size_t)val);
+         }
+         else
+         {
+            duk_push_lstring(c, (const char *)u->p, (duk_size_t)val);
+         }
+         u->p += (HB_SIZE)val;
+         break;
+
+      case 6:
+         if (val == HB_DUK_CBOR_SHAREABLE)
+         {
+            hb_duk_unsnap_object(c, u, u->nShared++, iDepth);
+         }
+         else if (val == HB_DUK_CBOR_SHAREDREF)
+         {
+            val = hb_duk_cbor_expect(c, u, 0);
+            if (val >= (HB_U64)u->nShared)
+            {
+               hb_duk_unsnap_corrupt(c);
+            }
+            duk_get_prop_index(c, u->iShared, (duk_uarridx_t)val);
+         }
+         else
+         {
+            hb_duk_unsnap_corrupt(c);
+         }
+         break;
+
+      default:
+         hb_duk_unsnap_corrupt(c);
+   }
+}
+
+static duk_ret_t hb_duk_snap_load_raw(duk_context *c, void *udata)
+{
+   HB_DUK_UNSNAP *u = (HB_DUK_UNSNAP *)udata;
+
+   u->iShared = duk_push_bare_array(c);
+   if (u->p >= u->end || *u->p++ != 0x9F)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   for (;;)
+   {
+      duk_size_t plen;
+      const char *path;
+
+      if (u->p >= u->end)
+      {
+         hb_duk_unsnap_corrupt(c);
+      }
+      if (*u->p == 0xFF)
+      {
+         u->p++;
+         break;
+      }
+      if (hb_duk_cbor_expect(c, u, 4) != 2)
+      {
+         hb_duk_unsnap_corrupt(c);
+      }
+      path = hb_duk_cbor_expect_data(c, u, 3, &plen);
+      if (!hb_duk_snap_resolve(c, path, plen))
+      {
+         (void)duk_generic_error(c, "snapshot: builtin not found: %.*s", (int)plen, path);
+      }
+      hb_duk_unsnap_props(c, u, duk_get_top_index(c), 0);
+      duk_pop(c);
+   }
+   if (u->p != u->end)
+   {
+      hb_duk_unsnap_corrupt(c);
+   }
+   return 0;
+}
+
+static void hb_duk_snap_header(HB_DUK_SNAP_HEADER *hdr, HB_SIZE length)
+{
+   memset(hdr, 0, sizeof(HB_DUK_SNAP_HEADER));
+   memcpy(hdr->magic, HB_DUK_SNAP_MAGIC, sizeof(hdr->magic));
+   hdr->version = (HB_U32)DUK_VERSION;
+   hdr->ptrsize = (HB_U32)sizeof(void *);
+   hdr->length = (HB_U64)length;
+}
+
+/* 編碼目前全局環境, 成功時結果在 snap->buf/len, 由呼叫者以 hb_duk_snap_release 釋放 */
+static HB_BOOL hb_duk_snap_capture(duk_context *c, HB_DUK_SNAP *snap)
+{
+   HB_BOOL fOK = HB_FALSE;
+
+   memset(snap, 0, sizeof(HB_DUK_SNAP));
+   snap->ref = duk_create_heap_default();
+   if (snap->ref != NULL)
+   {
+      hb_duk_async_install(snap->ref);   /* Promise 等原生函數視同內建對象 */
+      fOK = duk_safe_call(c, hb_duk_snap_save_raw, snap, 0, 1) == DUK_EXEC_SUCCESS;
+      if (!fOK)
+      {
+         snap->szError = hb_strdup(duk_safe_to_string(c, -1));
+      }
+      duk_pop(c);
+   }
+   return fOK;
+}
+
+/* 將 CBOR 快照主體套用到目前全局環境 */
+static HB_BOOL hb_duk_snap_apply(duk_context *c, const char *data, HB_SIZE len)
+{
+   HB_DUK_UNSNAP u;
+   duk_int_t rc;
+
+   memset(&u, 0, sizeof(u));
+   u.p = (const HB_UCHAR *)data;
+   u.end = (const HB_UCHAR *)data + len;
+   rc = duk_safe_call(c, hb_duk_snap_load_raw, &u, 0, 1);
+   duk_pop(c);
+   return rc == DUK_EXEC_SUCCESS;
+}
+
+/* 保存 heap 快照: DUK_SNAPSHOT_SAVE([hHeap,] cFile) */
+HB_FUNC(DUK_SNAPSHOT_SAVE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx = hb_duk_param_ctx(pDuk, hb_duk_realm_param());
+   const char *filename = hb_parc(iBase + 1);
+   HB_DUK_SNAP_HEADER hdr;
+   HB_DUK_SNAP snap;
+   HB_BOOL fOK = HB_FALSE;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (filename == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (hb_duk_snap_capture(ctx, &snap))
+   {
+      hb_duk_snap_header(&hdr, snap.len);
+      fOK = hb_duk_file_store(filename, &hdr, sizeof(hdr), snap.buf, snap.len);
+   }
+
+   if (!fOK)
+   {
+      /* 無法保存的值 (如閉包) 以錯誤說明指出其路徑 */
+      hb_errRT_BASE(EG_CREATE, 2010, snap.szError, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+   }
+   else
+   {
+      hb_retl(HB_TRUE);
+   }
+   hb_duk_snap_release(&snap);
+}
+
+/* 將快照還原到 heap (通常為剛建立的 heap): DUK_SNAPSHOT_LOAD([hHeap,] cFile)
+ * 快照含位元組碼, 與 .dukbc 快取一樣只應載入可信任的文件 */
+HB_FUNC(DUK_SNAPSHOT_LOAD)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx = hb_duk_param_ctx(pDuk, hb_duk_realm_param());
+   const char *filename = hb_parc(iBase + 1);
+   HB_DUK_SNAP_HEADER hdr;
+   HB_DUK_MAP map;
+   HB_BOOL fOK = HB_FALSE;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (filename == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (!hb_duk_map_open(filename, &map))
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_snap_header(&hdr, map.len >= sizeof(hdr) ? map.len - sizeof(hdr) : 0);
+   if (map.len > sizeof(hdr) && memcmp(map.data, &hdr, sizeof(hdr)) == 0)
+   {
+      fOK = hb_duk_snap_apply(ctx, map.data + sizeof(hdr), map.len - sizeof(hdr));
+   }
+   hb_duk_map_close(&map);
+
+   if (!fOK)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+   hb_retl(HB_TRUE);
+}
+
+/* 檢查點 (DUK_CHECKPOINT/DUK_RESET): 記錄自全局對象可達的每個對象 (含閉包的作用域記錄)
+ * 的自身屬性及原型, 重設時刪除新增的屬性並改寫與記錄不同的屬性. 對象及閉包環境本身
+ * 保持不變, 不需重建內建對象或重新載入函數. 記錄為 heap stash 中的陣列, 每個對象
+ * 佔 HB_DUK_CP_SLOTS 項: [對象, 原型, 屬性 [key, 旗標, 值, setter, ...], 屬性名集合, 緩衝區內容] */
+#define HB_DUK_CP_ENUM       (HB_DUK_SNAP_ENUM | DUK_ENUM_INCLUDE_HIDDEN | DUK_ENUM_INCLUDE_SYMBOLS)
+#define HB_DUK_CP_SLOTS      5
+
+/* 緩衝區對象的索引屬性是虛擬的, 內容另行記錄 */
+static HB_BOOL hb_duk_cp_is_index(const char *key, duk_size_t klen)
+{
+   duk_size_t i;
+
+   if (klen == 0 || klen > 10 || (klen > 1 && key[0] == '0'))
+   {
+      return HB_FALSE;
+   }
+   for (i = 0; i < klen; i++)
+   {
+      if (key[i] < '0' || key[i] > '9')
+      {
+         return HB_FALSE;
+      }
+   }
+   return HB_TRUE;
+}
+
+/* 尚未記錄的對象加入記錄陣列 (堆疊 0) 的尾端, 其餘欄位待處理時填入 */
+static void hb_duk_cp_enqueue(duk_context *c, HB_DUK_PTRMAP *seen, duk_idx_t idx)
+{
+   if (duk_is_object(c, idx) && hb_duk_ptrmap_get(seen, duk_get_heapptr(c, idx)) < 0)
+   {
+      duk_uarridx_t base = (duk_uarridx_t)duk_get_length(c, 0);
+      int i;
+
+      hb_duk_ptrmap_put(seen, duk_get_heapptr(c, idx), (int)(base / HB_DUK_CP_SLOTS));
+      duk_dup(c, idx);
+      duk_put_prop_index(c, 0, base);
+      for (i = 1; i < HB_DUK_CP_SLOTS; i++)
+      {
+         duk_push_undefined(c);
+         duk_put_prop_index(c, 0, base + (duk_uarridx_t)i);
+      }
+   }
+}
+
+/* 廣度優先記錄對象圖, 返回記錄陣列 */
+static duk_ret_t hb_duk_cp_record_raw(duk_context *c, void *udata)
+{
+   HB_DUK_PTRMAP *seen = (HB_DUK_PTRMAP *)udata;
+   duk_uarridx_t base;
+
+   duk_push_array(c);                          /* 0: 記錄 */
+
+   /* global stash 是全局對象的隱藏屬性, 存放 eval 快取, 函數句柄等綁定內部狀態, 不可還原;
+    * 在此建立並標記為已見, 全局對象的記錄中保留指向它的屬性 */
+   duk_push_global_stash(c);
+   hb_duk_ptrmap_put(seen, duk_get_heapptr(c, -1), 0);
+   duk_pop(c);
+
+   duk_push_global_object(c);
+   hb_duk_cp_enqueue(c, seen, 1);
+   duk_pop(c);
+
+   for (base = 0; base < (duk_uarridx_t)duk_get_length(c, 0); base += HB_DUK_CP_SLOTS)
+   {
+      duk_uarridx_t nProp;
+      duk_idx_t n;
+      HB_BOOL fBuffer;
+
+      duk_get_prop_index(c, 0, base);          /* 1: 對象 */
+      fBuffer = duk_is_buffer_data(c, 1);
+
+      duk_get_prototype(c, 1);
+      hb_duk_cp_enqueue(c, seen, -1);
+      duk_put_prop_index(c, 0, base + 1);
+
+      duk_push_array(c);                       /* 2: 屬性 */
+      duk_push_bare_object(c);                 /* 3: 屬性名集合 */
+      duk_enum(c, 1, HB_DUK_CP_ENUM);          /* 4 */
+      nProp = 0;
+      while (duk_next(c, 4, 0))                /* 5: key */
+      {
+         duk_size_t klen;
+         const char *key = duk_get_lstring(c, 5, &klen);
+         int iFlags;
+
+         if (fBuffer && hb_duk_cp_is_index(key, klen))
+         {
+            duk_pop(c);
+            continue;
+         }
+         duk_dup(c, 5);
+         duk_push_true(c);
+         duk_put_prop(c, 3);
+         duk_dup(c, 5);
+         duk_get_prop_desc(c, 1, 0);           /* 6: desc */
+         iFlags = hb_duk_snap_desc_flags(c, 6);
+         duk_dup(c, 5);
+         duk_put_prop_index(c, 2, nProp);
+         duk_push_int(c, iFlags);
+         duk_put_prop_index(c, 2, nProp + 1);
+         duk_get_prop_string(c, 6, (iFlags & HB_DUK_SNAP_ACCESSOR) ? "get" : "value");
+         hb_duk_cp_enqueue(c, seen, -1);
+         duk_put_prop_index(c, 2, nProp + 2);
+         if (iFlags & HB_DUK_SNAP_ACCESSOR)
+         {
+            duk_get_prop_string(c, 6, "set");
+            hb_duk_cp_enqueue(c, seen, -1);
+         }
+         else
+         {
+            duk_push_undefined(c);
+         }
+         duk_put_prop_index(c, 2, nProp + 3);
+         nProp += 4;
+         duk_pop_2(c);
+      }
+      duk_pop(c);
+      duk_put_prop_index(c, 0, base + 3);
+      duk_put_prop_index(c, 0, base + 2);
+
+      /* 閉包的作用域記錄不是屬性, 由引擎列出 */
+      n = duk_hb_push_scope_records(c, 1);
+      while (n-- > 0)
+      {
+         hb_duk_cp_enqueue(c, seen, -1);
+         duk_pop(c);
+      }
+
+      if (fBuffer)
+      {
+         duk_size_t len;
+         void *data = duk_get_buffer_data(c, 1, &len);
+         void *copy = duk_push_fixed_buffer(c, len);
+
+         if (len > 0)
+         {
+            memcpy(copy, data, len);
+         }
+         duk_put_prop_index(c, 0, base + 4);
+      }
+      duk_pop(c);
+   }
+   return 1;
+}
+
+/* 依記錄還原每個對象 */
+static duk_ret_t hb_duk_cp_restore_raw(duk_context *c, void *udata)
+{
+   PHB_DUK pDuk = (PHB_DUK)udata;
+   duk_uarridx_t base, nLen;
+
+   duk_push_heapptr(c, pDuk->pCheckpoint);     /* 0: 記錄 */
+   nLen = (duk_uarridx_t)duk_get_length(c, 0);
+   for (base = 0; base < nLen; base += HB_DUK_CP_SLOTS)
+   {
+      HB_BOOL fBuffer;
+
+      duk_get_prop_index(c, 0, base);          /* 1: 對象 */
+      duk_get_prop_index(c, 0, base + 2);      /* 2: 屬性 */
+      fBuffer = duk_is_buffer_data(c, 1);
+
+      /* 改寫值或屬性旗標已變更的屬性; 有記錄以外的屬性時才逐一檢查並刪除,
+       * 包括不可配置的全局 var/function 宣告 */
+      if (duk_hb_restore_props(c, 1, 2) > 0)
+      {
+         duk_get_prop_index(c, 0, base + 3);   /* 3: 屬性名集合 */
+         duk_enum(c, 1, HB_DUK_CP_ENUM);       /* 4 */
+         while (duk_next(c, 4, 0))             /* 5: key */
+         {
+            duk_size_t klen;
+            const char *key = duk_get_lstring(c, 5, &klen);
+
+            if (!(fBuffer && hb_duk_cp_is_index(key, klen)))
+            {
+               duk_dup(c, 5);
+               if (!duk_has_prop(c, 3))
+               {
+                  duk_hb_del_prop_force(c, 1);
+                  continue;
+               }
+            }
+            duk_pop(c);
+         }
+         duk_pop_2(c);
+      }
+
+      duk_get_prop_index(c, 0, base + 1);      /* 3: 原型 */
+      duk_get_prototype(c, 1);                 /* 4 */
+      if (!duk_strict_equals(c, 3, 4))
+      {
+         duk_pop(c);
+         duk_set_prototype(c, 1);
+      }
+
+      if (fBuffer)
+      {
+         duk_size_t len, nSaved;
+         void *data = duk_get_buffer_data(c, 1, &len);
+         void *saved;
+
+         duk_get_prop_index(c, 0, base + 4);
+         saved = duk_get_buffer(c, -1, &nSaved);
+         if (data != NULL && len == nSaved && len > 0)
+         {
+            memcpy(data, saved, len);
+         }
+         duk_pop(c);
+      }
+      duk_set_top(c, 1);
+   }
+   return 0;
+}
+
+/* 記錄目前狀態為 DUK_RESET 的還原點 (通常在執行啟動腳本之後): DUK_CHECKPOINT([hHeap])
+ * 閉包及其捕獲的變量一併記錄; 重設的成本與記錄的屬性數成正比, 與重建 heap 無關 */
+HB_FUNC(DUK_CHECKPOINT)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   HB_DUK_PTRMAP seen;
+   duk_int_t rc;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* realm 不支援檢查點, 以新的 realm 取代即可 */
+   if (hb_duk_realm_param() != NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_ptrmap_init(&seen, 1024);
+   rc = duk_safe_call(pDuk->ctx, hb_duk_cp_record_raw, &seen, 0, 1);
+   hb_duk_ptrmap_free(&seen);
+   if (rc != DUK_EXEC_SUCCESS)
+   {
+      duk_pop(pDuk->ctx);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 記錄釘選在 heap stash, 取代之前的檢查點 */
+   pDuk->pCheckpoint = duk_get_heapptr(pDuk->ctx, -1);
+   duk_push_heap_stash(pDuk->ctx);
+   duk_swap_top(pDuk->ctx, -2);
+   duk_put_prop_string(pDuk->ctx, -2, "hbCheckpoint");
+   duk_pop(pDuk->ctx);
+   hb_retl(HB_TRUE);
+}
+
+/* 回到檢查點的狀態, 沒有檢查點時換上全新的全局環境: DUK_RESET([hHeap])
+ * heap 本身 (字串表, 分配器 slab, 已註冊回調) 保持不變, 請求期間建立的對象不再可達.
+ * 有檢查點時全局環境不變, eval 快取及函數句柄仍然有效; 否則句柄仍指向舊環境中的函數 */
+HB_FUNC(DUK_RESET)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 不能在 JavaScript 執行期間 (如回調中) 更換環境; realm 以新的 realm 取代即可 */
+   if (pDuk->iExecDepth > 0 || hb_duk_realm_param() != NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 清除殘留的堆疊值; 待執行的工作及計時器 (含 realm 的) 一併捨棄 */
+   duk_set_top(pDuk->ctx, 0);
+   hb_duk_jobs_clear(pDuk);
+
+   if (pDuk->pCheckpoint != NULL)
+   {
+      if (duk_safe_call(pDuk->ctx, hb_duk_cp_restore_raw, pDuk, 0, 1) != DUK_EXEC_SUCCESS)
+      {
+         duk_pop(pDuk->ctx);
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+      duk_pop(pDuk->ctx);
+      hb_retl(HB_TRUE);
+      return;
+   }
+
+   /* 初始執行緒無法釋放, 只換上空的全局對象 */
+   if (pDuk->ctx == pDuk->heap)
+   {
+      duk_push_bare_object(pDuk->heap);
+      duk_set_global_object(pDuk->heap);
+   }
+
+   /* 新執行緒釘選在 heap stash, 取代舊執行緒後舊環境即不可達 */
+   duk_push_thread_new_globalenv(pDuk->heap);
+   ctx = duk_get_context(pDuk->heap, -1);
+   duk_push_heap_stash(pDuk->heap);
+   duk_dup(pDuk->heap, -2);
+   duk_put_prop_string(pDuk->heap, -2, "hbRealm");
+   duk_pop_2(pDuk->heap);
+   pDuk->ctx = ctx;
+   hb_duk_async_install(ctx);
+
+   /* 已編譯的 eval 函數綁定舊的全局環境 */
+   hb_duk_cache_reset(ctx, &pDuk->cache);
+   hb_retl(HB_TRUE);
+}
+
+/* 創建新的 JavaScript 對象 */
+HB_FUNC(DUK_PUSH_OBJECT)
+{
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   duk_push_object(ctx);
+   hb_retni(duk_get_top_index(ctx));
+}
+
+/* 設置對象屬性 */
+HB_FUNC(DUK_PUT_PROP_STRING)
+{
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   const char *key = hb_parc(iBase + 2);
+   const char *value = hb_parc(iBase + 3);
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (key == NULL || value == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   hb_duk_push_string_item(ctx, hb_param(iBase + 3, HB_IT_STRING));
+   duk_put_prop_lstring(ctx, obj_idx, key, hb_parclen(iBase + 2));
+   hb_retl(HB_TRUE);
+}
+
+/* 獲取對象屬性 */
+HB_FUNC(DUK_GET_PROP_STRING)
+{
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   const char *key = hb_parc(iBase + 2);
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (key == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   duk_get_prop_lstring(ctx, obj_idx, key, hb_parclen(iBase + 2));
+   if (duk_is_string(ctx, -1))
+   {
+      hb_duk_retstr(ctx, -1);
+   }
+   else if (duk_is_number(ctx, -1))
+   {
+      hb_retnd(duk_get_number(ctx, -1));
+   }
+   else if (duk_is_boolean(ctx, -1))
+   {
+      hb_retl(duk_get_boolean(ctx, -1));
+   }
+   else
+   {
+      hb_duk_retstr(ctx, -1);
+   }
+   duk_pop(ctx);
+}
+
+/* 調用 JavaScript 函數: DUK_CALL_FUNCTION([hHeap,] cName, nArgs, [nTimeoutMs]) */
+HB_FUNC(DUK_CALL_FUNCTION)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *func_name = hb_parc(iBase + 1);
+   duk_int_t nargs = hb_parni(iBase + 2);
+   const char *error;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (func_name == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   duk_get_global_lstring(ctx, func_name, hb_parclen(iBase + 1));
+   if (!duk_is_function(ctx, -1))
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   hb_duk_exec_begin(pDuk, pRealm, hb_parnint(iBase + 3), &exec);
+   rc = duk_pcall(ctx, nargs);
+   hb_duk_exec_end(pDuk, &exec);
+   hb_duk_lat_record(pDuk, exec.nStart, "call:", func_name, hb_parclen(iBase + 1));
+   if (rc != 0)
+   {
+      error = duk_safe_to_string(ctx, -1);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   hb_duk_retstr(ctx, -1);
+   duk_pop(ctx);
+}
+
+/* 以 Harbour 參數調用 JavaScript 函數並以 Harbour 原生類型返回結果 */
+HB_FUNC(DUK_CALL_FUNCTION_VALUE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *func_name = hb_parc(iBase + 1);
+   int iPCount = hb_pcount();
+   int i;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (func_name == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   duk_get_global_lstring(ctx, func_name, hb_parclen(iBase + 1));
+   if (!duk_is_function(ctx, -1))
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   for (i = iBase + 2; i <= iPCount; i++)
+   {
+      if (!hb_duk_push_item_safe(ctx, hb_param(i, HB_IT_ANY)))
+      {
+         /* 彈出錯誤對象, 已推入的參數和函數 */
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop_n(ctx, i - iBase);
+         return;
+      }
+   }
+
+   hb_duk_exec_begin(pDuk, pRealm, 0, &exec);
+   rc = duk_pcall(ctx, iPCount > iBase + 1 ? iPCount - iBase - 1 : 0);
+   /* 結果在執行時限內轉換, getter 和 Proxy trap 同樣受逾時約束 */
+   if (rc == 0 && !hb_duk_get_item_safe(ctx, -1, hb_stackReturnItem()))
+   {
+      duk_remove(ctx, -2);
+      rc = DUK_EXEC_ERROR;
+   }
+   hb_duk_exec_end(pDuk, &exec);
+   hb_duk_lat_record(pDuk, exec.nStart, "call:", func_name, hb_parclen(iBase + 1));
+   if (rc != 0)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   duk_pop(ctx);
+}
+
+/* 查找全局函數一次並返回句柄, 之後的調用不再需要名稱查找 */
+HB_FUNC(DUK_GET_FUNCTION_HANDLE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   const char *func_name = hb_parc(iBase + 1);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx;
+   PHB_DUK_FUNC pFunc;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (func_name == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   ctx = hb_duk_param_ctx(pDuk, pRealm);
+   duk_get_global_lstring(ctx, func_name, hb_parclen(iBase + 1));
+   if (!duk_is_function(ctx, -1))
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   /* 釘選在 heap stash 中; realm 的函數仍在 realm 的執行緒上調用, 受其記憶體和時間預算約束 */
+   pFunc = (PHB_DUK_FUNC)hb_gcAllocate(sizeof(HB_DUK_FUNC), &s_gcDukFuncFuncs);
+   pFunc->heapptr = duk_get_heapptr(ctx, -1);
+   pFunc->szName = hb_strdup(func_name);
+   if (ctx != pDuk->ctx)
+   {
+      duk_xmove_top(pDuk->ctx, ctx, 1);
+   }
+   pFunc->iSlot = hb_duk_func_pin(pDuk);
+   pFunc->pDuk = pDuk;
+   hb_xRefInc(pDuk);
+   pFunc->pRealm = pRealm;
+   if (pRealm != NULL)
+   {
+      hb_gcRefInc(pRealm);
+   }
+   hb_retptrGC(pFunc);
+}
+
+/* 以函數句柄調用 JavaScript 函數, 參數與結果皆為 Harbour 原生類型 */
+HB_FUNC(DUK_CALL_HANDLE)
+{
+   PHB_DUK_FUNC pFunc = (PHB_DUK_FUNC)hb_parptrGC(&s_gcDukFuncFuncs, 1);
+   duk_context *ctx;
+   int iPCount = hb_pcount();
+   int i;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (pFunc == NULL || pFunc->pDuk == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   ctx = hb_duk_param_ctx(pFunc->pDuk, pFunc->pRealm);
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   duk_push_heapptr(ctx, pFunc->heapptr);
+   for (i = 2; i <= iPCount; i++)
+   {
+      if (!hb_duk_push_item_safe(ctx, hb_param(i, HB_IT_ANY)))
+      {
+         /* 彈出錯誤對象, 已推入的參數和函數 */
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop_n(ctx, i);
+         return;
+      }
+   }
+
+   hb_duk_exec_begin(pFunc->pDuk, pFunc->pRealm, 0, &exec);
+   rc = duk_pcall(ctx, iPCount > 1 ? iPCount - 1 : 0);
+   if (rc == 0 && !hb_duk_get_item_safe(ctx, -1, hb_stackReturnItem()))
+   {
+      duk_remove(ctx, -2);
+      rc = DUK_EXEC_ERROR;
+   }
+   hb_duk_exec_end(pFunc->pDuk, &exec);
+   hb_duk_lat_record(pFunc->pDuk, exec.nStart, "call:", pFunc->szName, strlen(pFunc->szName));
+   if (rc != 0)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
+   }
+
+   duk_pop(ctx);
+}
+
+/* DUK_CALL_BATCH 的批次狀態, 在單一保護調用中逐行執行 */
+typedef struct
+{
+   void    *heapptr;
+   PHB_ITEM pRows;
+   PHB_ITEM pResults;
+   PHB_ITEM pErrors;
+   HB_BOOL  fStop;
+   HB_SIZE  nDone;
+} HB_DUK_BATCH;
+
+static void hb_duk_batch_error(duk_context *c, HB_DUK_BATCH *pBatch, HB_SIZE nRow)
+{
+   if (pBatch->pErrors != NULL)
+   {
+      duk_size_t len;
+      const char *msg = duk_safe_to_lstring(c, -1, &len);
+
+      hb_arraySetCL(pBatch->pErrors, nRow, msg, (HB_SIZE)len);
+   }
+}
+
+/* 每行為參數陣列, 非陣列值視為單一參數; 停止模式下錯誤直接拋出到 safe_call 邊界.
+ * 參數和結果以受保護的轉換進行, 轉換失敗與調用失敗同樣記為該行的錯誤 */
+static duk_ret_t hb_duk_batch_raw(duk_context *c, void *udata)
+{
+   HB_DUK_BATCH *pBatch = (HB_DUK_BATCH *)udata;
+   HB_SIZE nRows = hb_arrayLen(pBatch->pRows), nRow;
+   duk_idx_t nTop = duk_get_top(c);
+
+   for (nRow = 1; nRow <= nRows; nRow++)
+   {
+      PHB_ITEM pRow = hb_arrayGetItemPtr(pBatch->pRows, nRow);
+      duk_idx_t nArgs;
+      HB_BOOL fOK = HB_TRUE;
+
+      duk_push_heapptr(c, pBatch->heapptr);
+      if (HB_IS_ARRAY(pRow))
+      {
+         HB_SIZE nLen = hb_arrayLen(pRow), n;
+
+         duk_require_stack(c, (duk_idx_t)nLen);
+         for (n = 1; n <= nLen && fOK; n++)
+         {
+            fOK = hb_duk_push_item_safe(c, hb_arrayGetItemPtr(pRow, n));
+         }
+         nArgs = (duk_idx_t)nLen;
+      }
+      else
+      {
+         fOK = hb_duk_push_item_safe(c, pRow);
+         nArgs = 1;
+      }
+
+      if (fOK)
+      {
+         if (pBatch->fStop)
+         {
+            duk_call(c, nArgs);
+         }
+         else
+         {
+            fOK = duk_pcall(c, nArgs) == DUK_EXEC_SUCCESS;
+         }
+      }
+      if (fOK && !hb_duk_get_item_safe(c, -1, hb_arrayGetItemPtr(pBatch->pResults, nRow)))
+      {
+         fOK = HB_FALSE;
+      }
+
+      if (!fOK)
+      {
+         if (pBatch->fStop)
+         {
+            return duk_throw(c);
+         }
+         hb_duk_batch_error(c, pBatch, nRow);
+      }
+      duk_set_top(c, nTop);
+      pBatch->nDone = nRow;
+   }
+   return 0;
+}
+
+/* 對多組參數批次調用同一函數, 進入與錯誤處理開銷每批只支付一次
+ * DUK_CALL_BATCH(hFunc | [hHeap,] cName, aRows, [lStopOnError], [@aErrors]) */
+HB_FUNC(DUK_CALL_BATCH)
+{
+   PHB_DUK_FUNC pFunc = (PHB_DUK_FUNC)hb_parptrGC(&s_gcDukFuncFuncs, 1);
+   PHB_DUK pDuk;
+   PHB_DUK_REALM pRealm = NULL;
+   duk_context *ctx;
+   HB_DUK_BATCH batch;
+   PHB_ITEM pRows;
+   int iBase;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   if (pFunc != NULL)
+   {
+      pDuk = pFunc->pDuk;
+      pRealm = pFunc->pRealm;
+      iBase = 1;
+   }
+   else
+   {
+      pDuk = hb_duk_param(&iBase);
+      pRealm = hb_duk_realm_param();
+      iBase++;
+   }
+
+   ctx = hb_duk_param_ctx(pDuk, pRealm);
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pRows = hb_param(iBase + 1, HB_IT_ARRAY);
+   if (pRows == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 函數在批次期間保留在堆疊上 */
+   if (pFunc != NULL)
+   {
+      duk_push_heapptr(ctx, pFunc->heapptr);
+   }
+   else
+   {
+      const char *func_name = hb_parc(iBase);
+
+      if (func_name == NULL)
+      {
+         hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+      duk_get_global_lstring(ctx, func_name, hb_parclen(iBase));
+      if (!duk_is_function(ctx, -1))
+      {
+         hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop(ctx);
+         return;
+      }
+   }
+
+   batch.heapptr = duk_get_heapptr(ctx, -1);
+   batch.pRows = pRows;
+   batch.pResults = hb_itemArrayNew(hb_arrayLen(pRows));
+   batch.pErrors = HB_ISBYREF(iBase + 3) ? hb_itemArrayNew(hb_arrayLen(pRows)) : NULL;
+   batch.fStop = hb_parldef(iBase + 2, HB_TRUE);
+   batch.nDone = 0;
+
+   hb_duk_exec_begin(pDuk, pRealm, 0, &exec);
+   rc = duk_safe_call(ctx, hb_duk_batch_raw, &batch, 0, 1);
+   hb_duk_exec_end(pDuk, &exec);
+   if (rc != DUK_EXEC_SUCCESS)
+   {
+      /* 停止模式: 第 nDone + 1 行失敗, 之後的行不執行 */
+      hb_duk_batch_error(ctx, &batch, batch.nDone + 1);
+      if (batch.pErrors == NULL)
+      {
+         duk_pop_2(ctx);
+         hb_itemRelease(batch.pResults);
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+   }
+   duk_pop_2(ctx);
+
+   if (batch.pErrors != NULL)
+   {
+      hb_itemParamStoreRelease(iBase + 3, batch.pErrors);
+   }
+   hb_itemReturnRelease(batch.pResults);
+}
+
+/* 任務句柄: GC 時只歸還槽位, 暫停中的執行緒連同其 C 堆疊一併捨棄 */
+static HB_GARBAGE_FUNC(hb_duk_task_gc)
+{
+   PHB_DUK_TASK pTask = (PHB_DUK_TASK)Cargo;
+
+   if (pTask->pDuk != NULL)
+   {
+      if (pTask->pDuk->ctx != NULL && pTask->iSlot >= 0)
+      {
+         pTask->pDuk->pFuncFree[pTask->pDuk->iFuncFree++] = pTask->iSlot;
+      }
+#if defined(HB_OS_WIN)
+      if (pTask->fiber != NULL)
+      {
+         DeleteFiber(pTask->fiber);
+         pTask->fiber = NULL;
+      }
+#elif defined(HB_DUK_TASKS)
+      if (pTask->stack != NULL)
+      {
+         hb_xfree(pTask->stack);
+         pTask->stack = NULL;
+      }
+#endif
+      if (pTask->pRealm != NULL)
+      {
+         hb_gcRefFree(pTask->pRealm);
+         pTask->pRealm = NULL;
+      }
+      hb_duk_release(pTask->pDuk);
+      pTask->pDuk = NULL;
+      pTask->ctx = NULL;
+   }
+}
+
+static const HB_GC_FUNCS s_gcDukTaskFuncs =
+{
+   hb_duk_task_gc,
+   hb_gcDummyMark
+};
+
+static PHB_DUK_TASK hb_duk_task_param(void)
+{
+   PHB_DUK_TASK pTask = (PHB_DUK_TASK)hb_parptrGC(&s_gcDukTaskFuncs, 1);
+
+   return pTask != NULL && pTask->pDuk != NULL ? pTask : NULL;
+}
+
+#if defined(HB_DUK_TASKS)
+
+/* 切換回 DUK_TASK_RUN 的調用者 */
+static void hb_duk_task_leave(PHB_DUK_TASK pTask)
+{
+#if defined(HB_OS_WIN)
+   SwitchToFiber(pTask->caller);
+#else
+   swapcontext(&pTask->uc, &pTask->caller);
+#endif
+}
+
+/* 暫停正在執行的任務: 保存 heap 與執行狀態後返回調用者, 恢復時原樣還原 */
+static void hb_duk_task_yield(PHB_DUK_TASK pTask, duk_context *c)
+{
+   PHB_DUK pDuk = pTask->pDuk;
+   HB_MAXUINT nNow;
+
+   duk_suspend(c, &pTask->state);
+   nNow = hb_duk_clock_us();
+   pTask->nLeft = pDuk->nDeadline == 0 ? 0 : (pDuk->nDeadline > nNow ? pDuk->nDeadline - nNow : 1);
+   pDuk->nDeadline = 0;
+   pDuk->iExecDepth = 0;
+   hb_duk_realm_switch(pDuk, NULL);
+   pDuk->pTask = NULL;
+   pTask->iState = HB_DUK_TASK_SUSPENDED;
+
+   hb_duk_task_leave(pTask);
+
+   /* DUK_TASK_RUN 已設定 pTask 及時間片; 暫停的時間不計入逾時 */
+   hb_duk_realm_switch(pDuk, pTask->pRealm);
+   pDuk->iExecDepth = 1;
+   pDuk->nDeadline = pTask->nLeft == 0 ? 0 : hb_duk_clock_us() + pTask->nLeft;
+   duk_resume(c, &pTask->state);
+}
+
+/* 任務的進入點, 在任務自己的 C 堆疊上執行, 結束後不會返回 */
+static void hb_duk_task_main(PHB_DUK_TASK pTask)
+{
+   PHB_DUK pDuk = pTask->pDuk;
+   HB_DUK_EXEC exec;
+   duk_int_t rc;
+
+   hb_duk_exec_begin(pDuk, pTask->pRealm, pTask->nTimeout, &exec);
+   rc = duk_pcall(pTask->ctx, 0);
+   hb_duk_exec_end(pDuk, &exec);
+   pTask->iState = rc == DUK_EXEC_SUCCESS ? HB_DUK_TASK_DONE : HB_DUK_TASK_FAILED;
+   pDuk->pTask = NULL;
+   for (;;)
+   {
+      hb_duk_task_leave(pTask);
+   }
+}
+
+#if defined(HB_OS_WIN)
+static VOID CALLBACK hb_duk_task_entry(LPVOID lpParam)
+{
+   hb_duk_task_main((PHB_DUK_TASK)lpParam);
+}
+#else
+/* makecontext 只能傳遞 int 參數, 指標分成兩半 */
+static void hb_duk_task_entry(unsigned int lo, unsigned int hi)
+{
+   hb_duk_task_main((PHB_DUK_TASK)(HB_PTRUINT)(((HB_U64)hi << 32) | lo));
+}
+#endif
+
+/* 配置任務的 C 堆疊, 失敗時返回 HB_FALSE */
+static HB_BOOL hb_duk_task_stack(PHB_DUK_TASK pTask)
+{
+#if defined(HB_OS_WIN)
+   pTask->fiber = CreateFiberEx(64 * 1024, HB_DUK_TASK_STACK, 0, hb_duk_task_entry, pTask);
+   return pTask->fiber != NULL;
+#else
+   HB_U64 n = (HB_U64)(HB_PTRUINT)pTask;
+
+   if (getcontext(&pTask->uc) != 0)
+   {
+      return HB_FALSE;
+   }
+   pTask->stack = hb_xgrab(HB_DUK_TASK_STACK);
+   pTask->uc.uc_stack.ss_sp = pTask->stack;
+   pTask->uc.uc_stack.ss_size = HB_DUK_TASK_STACK;
+   pTask->uc.uc_link = NULL;
+   makecontext(&pTask->uc, (void (*)(void))hb_duk_task_entry, 2,
+               (unsigned int)(n & 0xFFFFFFFF), (unsigned int)(n >> 32));
+   return HB_TRUE;
+#endif
+}
+
+#endif /* HB_DUK_TASKS */
+
+/* 由執行器中斷鉤子調用 (duk_config.h 的 DUK_USE_HB_EXEC_YIELD): 任務的時間片用完時暫停.
+ * 只在任務最外層的執行中切換, 巢狀的 DUK_* 調用或 Harbour 回調仍在堆疊上時不切換 */
+void hb_duk_exec_yield(void *udata, void *thr)
+{
+#if defined(HB_DUK_TASKS)
+   PHB_DUK pDuk = (PHB_DUK)udata;
+
+   if (pDuk != NULL && pDuk->pTask != NULL && pDuk->iExecDepth == 1 && pDuk->iCallDepth == 0 &&
+       hb_duk_clock_us() >= pDuk->pTask->nSliceEnd)
+   {
+      hb_duk_task_yield(pDuk->pTask, (duk_context *)thr);
+   }
+#else
+   (void)udata;
+   (void)thr;
+#endif
+}
+
+/* taskYield(): 在任務中主動讓出, 返回是否確實暫停過 (任務外或巢狀調用中為 false) */
+static duk_ret_t hb_duk_task_yield_fn(duk_context *c)
+{
+#if defined(HB_DUK_TASKS)
+   PHB_DUK pDuk = hb_duk_from_ctx(c);
+
+   if (pDuk->pTask != NULL && pDuk->iExecDepth == 1 && pDuk->iCallDepth == 0)
+   {
+      hb_duk_task_yield(pDuk->pTask, c);
+      duk_push_true(c);
+      return 1;
+   }
+#endif
+   duk_push_false(c);
+   return 1;
+}
+
+/* 建立任務: DUK_TASK_NEW([hHeap,] cSource, [nTimeoutMs]), 源碼以 eval 方式編譯,
+ * 最後一個表達式的值為結果. 任務在第一次 DUK_TASK_RUN 時才開始執行 */
+HB_FUNC(DUK_TASK_NEW)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_DUK_REALM pRealm = hb_duk_realm_param();
+   duk_context *ctx = hb_duk_param_ctx(pDuk, pRealm);
+   const char *code = hb_parc(iBase + 1);
+   HB_MAXINT nTimeout = hb_parnint(iBase + 2);
+   PHB_DUK_TASK pTask;
+   duk_context *tctx;
+   HB_BOOL fOK;
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (code == NULL || nTimeout < 0)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* 新執行緒與 ctx 共用全局環境 */
+   duk_push_thread(ctx);
+   tctx = duk_get_context(ctx, -1);
+   if (duk_pcompile_lstring(tctx, DUK_COMPILE_EVAL, code, hb_parclen(iBase + 1)) != 0)
+   {
+      duk_pop(ctx);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pTask = (PHB_DUK_TASK)hb_gcAllocate(sizeof(HB_DUK_TASK), &s_gcDukTaskFuncs);
+   memset(pTask, 0, sizeof(HB_DUK_TASK));
+   pTask->iSlot = -1;
+   pTask->nTimeout = nTimeout;
+#if defined(HB_DUK_TASKS)
+   fOK = hb_duk_task_stack(pTask);
+#else
+   fOK = HB_FALSE;   /* 此平台無法切換 C 堆疊 */
+#endif
+   if (!fOK)
+   {
+      duk_pop(ctx);
+      hb_gcRefFree(pTask);
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pTask->ctx = tctx;
+   if (ctx != pDuk->ctx)
+   {
+      duk_xmove_top(pDuk->ctx, ctx, 1);
+   }
+   pTask->iSlot = hb_duk_func_pin(pDuk);
+   pTask->pDuk = pDuk;
+   hb_xRefInc(pDuk);
+   if (pRealm != NULL)
+   {
+      hb_gcRefInc(pRealm);
+      pTask->pRealm = pRealm;
+   }
+   hb_retptrGC(pTask);
+}
+
+/* 執行任務一個時間片: DUK_TASK_RUN(hTask, [nQuantumMs]), 暫停時返回 .T., 結束 (成功或失敗) 後返回 .F.
+ * 只能由 JavaScript 執行之外的 Harbour 排程迴圈調用 */
+HB_FUNC(DUK_TASK_RUN)
+{
+   PHB_DUK_TASK pTask = hb_duk_task_param();
+   HB_MAXINT nQuantum = hb_parnint(2);
+   PHB_DUK pDuk;
+
+   if (pTask == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pDuk = pTask->pDuk;
+   if (pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (pTask->iState >= HB_DUK_TASK_DONE)
+   {
+      hb_retl(HB_FALSE);
+      return;
+   }
+
+   /* 巢狀執行中 heap 不在頂層狀態, 不能切換到任務 */
+   if (pDuk->iExecDepth > 0 || pDuk->iCallDepth > 0 || pTask->iState == HB_DUK_TASK_RUNNING)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (nQuantum <= 0)
+   {
+      nQuantum = HB_DUK_TASK_QUANTUM_DEFAULT;
+   }
+   pTask->nSliceEnd = hb_duk_clock_us() + (HB_MAXUINT)nQuantum * 1000;
+#if defined(HB_DUK_TASKS)
+   pTask->iState = HB_DUK_TASK_RUNNING;
+   pDuk->pTask = pTask;
+#if defined(HB_OS_WIN)
+   pTask->caller = ConvertThreadToFiber(NULL);
+   if (pTask->caller == NULL)
+   {
+      pTask->caller = GetCurrentFiber();   /* 已是 fiber */
+   }
+   SwitchToFiber(pTask->fiber);
+#else
+   swapcontext(&pTask->caller, &pTask->uc);
+#endif
+#endif
+   hb_retl(pTask->iState < HB_DUK_TASK_DONE);
+}
+
+/* 獲取任務結果: DUK_TASK_RESULT(hTask, [@cError]), 尚未結束時返回 NIL;
+ * 失敗時錯誤訊息存入 cError, 未傳入 cError 時引發錯誤 */
+HB_FUNC(DUK_TASK_RESULT)
+{
+   PHB_DUK_TASK pTask = hb_duk_task_param();
+
+   if (pTask == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (pTask->pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (pTask->iState == HB_DUK_TASK_DONE)
+   {
+      /* 結果留在任務堆疊上, 可重複取得; 轉換失敗時只彈出錯誤對象 */
+      if (!hb_duk_get_item_safe(pTask->ctx, -1, hb_stackReturnItem()))
+      {
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop(pTask->ctx);
+      }
+   }
+   else if (pTask->iState == HB_DUK_TASK_FAILED)
+   {
+      if (HB_ISBYREF(2))
+      {
+         duk_size_t len;
+         const char *msg = duk_safe_to_lstring(pTask->ctx, -1, &len);
+
+         hb_itemParamStoreRelease(2, hb_itemPutCL(NULL, msg, (HB_SIZE)len));
+      }
+      else
+      {
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      }
+   }
+}
+
+/* Promise 與計時器: Duktape 2.7 的 Promise 內建對象只有未實作的樁函數,
+ * 此處以原生函數安裝到每個全局環境. 工作 (microtask) 佇列與計時器堆積
+ * 在 C 端維護, 回調本身釘選在 heap stash, 由 DUK_RUN_JOBS 驅動 */
+#define HB_DUK_P_STATE   DUK_HIDDEN_SYMBOL("hbState")    /* 0 等待, 1 已實現, 2 已拒絕 */
+#define HB_DUK_P_VALUE   DUK_HIDDEN_SYMBOL("hbValue")
+#define HB_DUK_P_REACT   DUK_HIDDEN_SYMBOL("hbReact")    /* 等待中的 [衍生 promise, onFulfilled, onRejected] */
+#define HB_DUK_P_TARGET  DUK_HIDDEN_SYMBOL("hbTarget")
+#define HB_DUK_P_RECORD  DUK_HIDDEN_SYMBOL("hbRecord")   /* 一組函數共用的狀態記錄 */
+#define HB_DUK_P_PROTO   DUK_HIDDEN_SYMBOL("hbProto")
+#define HB_DUK_P_INDEX   DUK_HIDDEN_SYMBOL("hbIndex")
+
+/* 工作種類 */
+#define HB_DUK_JOB_REACTION  0   /* [0, 衍生 promise, handler, value, state] */
+#define HB_DUK_JOB_THENABLE  1   /* [1, promise, thenable, then] */
+#define HB_DUK_JOB_CALLBACK  2   /* [2, fn] (queueMicrotask) */
+
+static void hb_duk_job_store(duk_context *c, PHB_DUK pDuk)
+{
+   if (pDuk->pJobStore == NULL)
+   {
+      duk_push_heap_stash(c);
+      duk_push_array(c);
+      pDuk->pJobStore = duk_get_heapptr(c, -1);
+      duk_put_prop_string(c, -2, "hbJobs");
+      duk_pop(c);
+   }
+   duk_push_heapptr(c, pDuk->pJobStore);
+}
+
+/* 以堆疊頂端 nItems 個值組成工作加入佇列, 並彈出這些值; 工作記錄當時的 realm, 執行時計入其預算 */
+static void hb_duk_job_push(duk_context *c, int iKind, duk_idx_t nItems)
+{
+   PHB_DUK pDuk = hb_duk_from_ctx(c);
+   duk_idx_t base = duk_get_top(c) - nItems, i;
+
+   hb_duk_job_store(c, pDuk);
+   if (pDuk->nJobTail >= pDuk->nJobRealmMax)
+   {
+      pDuk->nJobRealmMax = pDuk->nJobRealmMax == 0 ? 16 : pDuk->nJobRealmMax * 2;
+      pDuk->pJobRealm = (PHB_DUK_REALM *)hb_xrealloc(pDuk->pJobRealm, sizeof(PHB_DUK_REALM) * pDuk->nJobRealmMax);
+   }
+   pDuk->pJobRealm[pDuk->nJobTail] = pDuk->pRealm;
+   duk_push_array(c);
+   duk_push_int(c, iKind);
+   duk_put_prop_index(c, -2, 0);
+   for (i = 0; i < nItems; i++)
+   {
+      duk_dup(c, base + i);
+      duk_put_prop_index(c, -2, (duk_uarridx_t)(i + 1));
+   }
+   duk_put_prop_index(c, -2, pDuk->nJobTail++);
+   duk_pop_n(c, nItems + 1);
+}
+
+/* 清除待執行的工作及計時器 (DUK_RESET 時其所屬環境已不存在) */
+static void hb_duk_jobs_clear(PHB_DUK pDuk)
+{
+   if (pDuk->pJobStore != NULL || pDuk->pTimerStore != NULL)
+   {
+      duk_push_heap_stash(pDuk->heap);
+      duk_del_prop_string(pDuk->heap, -1, "hbJobs");
+      duk_del_prop_string(pDuk->heap, -1, "hbTimers");
+      duk_pop(pDuk->heap);
+   }
+   pDuk->pJobStore = NULL;
+   pDuk->nJobHead = pDuk->nJobTail = 0;
+   pDuk->pTimerStore = NULL;
+   pDuk->iTimers = 0;
+}
+
+/* 是否為 promise: 狀態須為自身屬性, 避免以 promise 為原型的對象被誤認 */
+static HB_BOOL hb_duk_is_promise(duk_context *c, duk_idx_t idx)
+{
+   HB_BOOL fPromise;
+
+   if (!duk_is_object(c, idx))
+   {
+      return HB_FALSE;
+   }
+   duk_push_string(c, HB_DUK_P_STATE);
+   duk_get_prop_desc(c, idx, 0);
+   fPromise = !duk_is_undefined(c, -1);
+   duk_pop(c);
+   return fPromise;
+}
+
+static void hb_duk_promise_init(duk_context *c, duk_idx_t idx)
+{
+   idx = duk_normalize_index(c, idx);
+   duk_push_int(c, 0);
+   duk_put_prop_string(c, idx, HB_DUK_P_STATE);
+   duk_push_array(c);
+   duk_put_prop_string(c, idx, HB_DUK_P_REACT);
+}
+
+/* 推入以 protoidx 處的對象為原型的新 promise */
+static void hb_duk_promise_push(duk_context *c, duk_idx_t protoidx)
+{
+   protoidx = duk_normalize_index(c, protoidx);
+   duk_push_object(c);
+   if (duk_is_object(c, protoidx))
+   {
+      duk_dup(c, protoidx);
+      duk_set_prototype(c, -2);
+   }
+   hb_duk_promise_init(c, -1);
+}
+
+/* 以堆疊頂端的值結算 promise (iState 1 實現, 2 拒絕) 並彈出該值, 已結算時忽略 */
+static void hb_duk_promise_settle(duk_context *c, duk_idx_t pidx, int iState)
+{
+   duk_size_t n, nLen;
+
+   pidx = duk_normalize_index(c, pidx);
+   duk_get_prop_string(c, pidx, HB_DUK_P_STATE);
+   if (duk_get_int(c, -1) != 0)
+   {
+      duk_pop_2(c);
+      return;
+   }
+   duk_pop(c);
+
+   duk_push_int(c, iState);
+   duk_put_prop_string(c, pidx, HB_DUK_P_STATE);
+   duk_dup_top(c);
+   duk_put_prop_string(c, pidx, HB_DUK_P_VALUE);
+
+   duk_get_prop_string(c, pidx, HB_DUK_P_REACT);   /* [ value reacts ] */
+   nLen = duk_get_length(c, -1);
+   for (n = 0; n < nLen; n++)
+   {
+      duk_get_prop_index(c, -1, (duk_uarridx_t)n);
+      duk_get_prop_index(c, -1, 0);
+      duk_get_prop_index(c, -2, (duk_uarridx_t)iState);
+      duk_dup(c, -5);
+      duk_push_int(c, iState);
+      hb_duk_job_push(c, HB_DUK_JOB_REACTION, 4);
+      duk_pop(c);
+   }
+   duk_pop(c);
+   duk_del_prop_string(c, pidx, HB_DUK_P_REACT);
+   duk_pop(c);
+}
 
-/* 自定義記憶體分配函數 */
-static void *hb_duktape_alloc(void *udata, duk_size_t size)
+static duk_ret_t hb_duk_get_then(duk_context *c, void *udata)
 {
-   (void)udata;  /* 避免未使用參數警告 */
-   return hb_xalloc(size);
+   (void)udata;
+   duk_get_prop_string(c, -1, "then");
+   return 1;
 }
 
-static void *hb_duktape_realloc(void *udata, void *ptr, duk_size_t size)
+/* 以堆疊頂端的值解決 promise 並彈出該值: thenable 排入工作, 其他值直接實現 */
+static void hb_duk_promise_resolve(duk_context *c, duk_idx_t pidx)
 {
-   (void)udata;  /* 避免未使用參數警告 */
-   return hb_xrealloc(ptr, size);
+   pidx = duk_normalize_index(c, pidx);
+   if (duk_is_object(c, -1))
+   {
+      if (duk_get_heapptr(c, -1) == duk_get_heapptr(c, pidx))
+      {
+         duk_pop(c);
+         duk_push_error_object(c, DUK_ERR_TYPE_ERROR, "promise resolved with itself");
+         hb_duk_promise_settle(c, pidx, 2);
+         return;
+      }
+      duk_dup_top(c);
+      if (duk_safe_call(c, hb_duk_get_then, NULL, 1, 1) != DUK_EXEC_SUCCESS)
+      {
+         duk_remove(c, -2);
+         hb_duk_promise_settle(c, pidx, 2);
+         return;
+      }
+      if (duk_is_callable(c, -1))
+      {
+         duk_dup(c, pidx);
+         duk_insert(c, -3);
+         hb_duk_job_push(c, HB_DUK_JOB_THENABLE, 3);
+         return;
+      }
+      duk_pop(c);
+   }
+   hb_duk_promise_settle(c, pidx, 1);
 }
 
-static void hb_duktape_free(void *udata, void *ptr)
+/* 解決函數 (magic 0 resolve, 1 reject), 同一組只有第一次調用有效 */
+static duk_ret_t hb_duk_promise_resolver(duk_context *c)
 {
-   (void)udata;  /* 避免未使用參數警告 */
-   hb_xfree(ptr);
+   duk_set_top(c, 1);
+   duk_push_current_function(c);                   /* [ arg fn ] */
+   duk_get_prop_string(c, 1, HB_DUK_P_RECORD);
+   duk_get_prop_string(c, -1, "done");
+   if (duk_to_boolean(c, -1))
+   {
+      return 0;
+   }
+   duk_pop(c);
+   duk_push_true(c);
+   duk_put_prop_string(c, -2, "done");
+   duk_pop(c);
+
+   duk_get_prop_string(c, 1, HB_DUK_P_TARGET);     /* [ arg fn promise ] */
+   duk_dup(c, 0);
+   if (duk_get_current_magic(c) == 0)
+   {
+      hb_duk_promise_resolve(c, 2);
+   }
+   else
+   {
+      hb_duk_promise_settle(c, 2, 2);
+   }
+   return 0;
 }
 
-/* 註冊 Duktape 對象到 Harbour 垃圾回收 */
-static HB_GARBAGE_FUNC(hb_duktape_gc)
+/* 推入 promise 的一組解決函數 [ resolve reject ] */
+static void hb_duk_promise_resolvers(duk_context *c, duk_idx_t pidx)
 {
-   void **ph = (void **)Cargo;
+   int i;
 
-   /* Check if pointer is not NULL to avoid multiple freeing */
-   if (ph && *ph)
+   pidx = duk_normalize_index(c, pidx);
+   duk_push_bare_object(c);
+   for (i = 0; i < 2; i++)
    {
-      /* Destroy the object */
-      duk_destroy_heap((duk_context *)*ph);
+      duk_push_c_function(c, hb_duk_promise_resolver, 1);
+      duk_set_magic(c, -1, i);
+      duk_dup(c, pidx);
+      duk_put_prop_string(c, -2, HB_DUK_P_TARGET);
+      duk_dup(c, -2 - i);
+      duk_put_prop_string(c, -2, HB_DUK_P_RECORD);
+   }
+   duk_remove(c, -3);
+}
 
-      /* set pointer to NULL to avoid multiple freeing */
-      *ph = NULL;
+/* new Promise(executor) */
+static duk_ret_t hb_duk_promise_ctor(duk_context *c)
+{
+   if (!duk_is_constructor_call(c))
+   {
+      return duk_type_error(c, "Promise requires 'new'");
+   }
+   if (!duk_is_callable(c, 0))
+   {
+      return duk_type_error(c, "Promise executor is not a function");
    }
+   duk_set_top(c, 1);
+   duk_push_this(c);
+   hb_duk_promise_init(c, 1);
+   hb_duk_promise_resolvers(c, 1);                 /* [ executor this resolve reject ] */
+   duk_dup(c, 0);
+   duk_dup(c, 2);
+   duk_dup(c, 3);
+   if (duk_pcall(c, 2) != DUK_EXEC_SUCCESS)
+   {
+      duk_dup(c, 3);
+      duk_swap_top(c, -2);
+      duk_call(c, 1);
+   }
+   return 0;
 }
 
-static const HB_GC_FUNCS s_gcDuktapeFuncs =
+/* Promise.prototype.then(onFulfilled, onRejected) */
+static duk_ret_t hb_duk_promise_then(duk_context *c)
 {
-   hb_duktape_gc,
-   hb_gcDummyMark
-};
+   int i, iState;
 
-/* 初始化 Duktape 引擎並註冊到 Harbour 垃圾回收 */
-HB_FUNC(DUK_INIT)
+   duk_set_top(c, 2);
+   duk_push_this(c);                               /* 2 */
+   if (!hb_duk_is_promise(c, 2))
+   {
+      return duk_type_error(c, "not a promise");
+   }
+   duk_get_prototype(c, 2);                        /* 3 */
+   hb_duk_promise_push(c, 3);                      /* 4 衍生 promise */
+
+   duk_push_array(c);                              /* 5 反應記錄 */
+   duk_dup(c, 4);
+   duk_put_prop_index(c, 5, 0);
+   for (i = 0; i < 2; i++)
+   {
+      if (duk_is_callable(c, i))
+         duk_dup(c, i);
+      else
+         duk_push_undefined(c);
+      duk_put_prop_index(c, 5, (duk_uarridx_t)(i + 1));
+   }
+
+   duk_get_prop_string(c, 2, HB_DUK_P_STATE);
+   iState = duk_get_int(c, -1);
+   duk_pop(c);
+   if (iState == 0)
+   {
+      duk_get_prop_string(c, 2, HB_DUK_P_REACT);
+      duk_dup(c, 5);
+      duk_put_prop_index(c, -2, (duk_uarridx_t)duk_get_length(c, -2));
+      duk_pop(c);
+   }
+   else
+   {
+      duk_dup(c, 4);
+      duk_get_prop_index(c, 5, (duk_uarridx_t)iState);
+      duk_get_prop_string(c, 2, HB_DUK_P_VALUE);
+      duk_push_int(c, iState);
+      hb_duk_job_push(c, HB_DUK_JOB_REACTION, 4);
+   }
+   duk_dup(c, 4);
+   return 1;
+}
+
+/* Promise.prototype.catch(onRejected) */
+static duk_ret_t hb_duk_promise_catch(duk_context *c)
 {
-   void **ph;
+   duk_set_top(c, 1);
+   duk_push_this(c);
+   duk_push_string(c, "then");
+   duk_push_undefined(c);
+   duk_dup(c, 0);
+   duk_call_prop(c, 1, 2);
+   return 1;
+}
 
-   if (ctx != NULL)
+/* finally 之後傳遞原值 (magic 0) 或再次拋出原因 (magic 1) */
+static duk_ret_t hb_duk_promise_thunk(duk_context *c)
+{
+   duk_push_current_function(c);
+   duk_get_prop_string(c, -1, HB_DUK_P_VALUE);
+   if (duk_get_current_magic(c) != 0)
    {
-      hb_retl(HB_TRUE);
-      return;
+      return duk_throw(c);
    }
+   return 1;
+}
 
-   ctx = duk_create_heap_default();
-   if (ctx == NULL)
+/* finally 的反應函數: 調用 onFinally, 待其結果完成後傳遞原結果 */
+static duk_ret_t hb_duk_promise_finally_fn(duk_context *c)
+{
+   duk_set_top(c, 1);
+   duk_push_current_function(c);                   /* 1 */
+   duk_get_prop_string(c, 1, HB_DUK_P_PROTO);      /* 2 */
+   hb_duk_promise_push(c, 2);                      /* 3 */
+   duk_get_prop_string(c, 1, HB_DUK_P_TARGET);
+   duk_call(c, 0);
+   hb_duk_promise_resolve(c, 3);
+
+   duk_push_string(c, "then");
+   duk_push_c_function(c, hb_duk_promise_thunk, 0);
+   duk_set_magic(c, -1, duk_get_current_magic(c));
+   duk_dup(c, 0);
+   duk_put_prop_string(c, -2, HB_DUK_P_VALUE);
+   duk_call_prop(c, 3, 1);
+   return 1;
+}
+
+/* Promise.prototype.finally(onFinally) */
+static duk_ret_t hb_duk_promise_finally(duk_context *c)
+{
+   int i;
+
+   duk_set_top(c, 1);
+   duk_push_this(c);                               /* 1 */
+   duk_push_string(c, "then");
+   for (i = 0; i < 2; i++)
    {
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      if (duk_is_callable(c, 0))
+      {
+         duk_push_c_function(c, hb_duk_promise_finally_fn, 1);
+         duk_set_magic(c, -1, i);
+         duk_dup(c, 0);
+         duk_put_prop_string(c, -2, HB_DUK_P_TARGET);
+         duk_get_prototype(c, 1);
+         duk_put_prop_string(c, -2, HB_DUK_P_PROTO);
+      }
+      else
+      {
+         duk_dup(c, 0);
+      }
    }
+   duk_call_prop(c, 1, 2);
+   return 1;
+}
 
-   /* 註冊到 Harbour 垃圾回收 */
-   ph = (void **)hb_gcAllocate(sizeof(duk_context *), &s_gcDuktapeFuncs);
-   *ph = ctx;
-   hb_retptrGC(ph);
+/* Promise.resolve(x) (magic 0), Promise.reject(r) (magic 1) */
+static duk_ret_t hb_duk_promise_static(duk_context *c)
+{
+   int iMagic = duk_get_current_magic(c);
+
+   duk_set_top(c, 1);
+   duk_push_this(c);                               /* 1 建構函數 */
+   duk_get_prop_string(c, 1, "prototype");         /* 2 */
+   if (iMagic == 0 && hb_duk_is_promise(c, 0))
+   {
+      duk_get_prototype(c, 0);
+      if (duk_strict_equals(c, -1, 2))
+      {
+         duk_dup(c, 0);
+         return 1;
+      }
+      duk_pop(c);
+   }
+   hb_duk_promise_push(c, 2);                      /* 3 */
+   duk_dup(c, 0);
+   if (iMagic == 0)
+   {
+      hb_duk_promise_resolve(c, 3);
+   }
+   else
+   {
+      hb_duk_promise_settle(c, 3, 2);
+   }
+   return 1;
 }
 
-/* 執行 JavaScript 代碼 */
-HB_FUNC(DUK_EVAL)
+/* Promise.all 的元素函數: 記錄結果, 全部完成時解決 */
+static duk_ret_t hb_duk_promise_all_fn(duk_context *c)
 {
-   const char *code = hb_parc(1);
-   const char *error;
-   const char *result;
+   duk_double_t remaining;
 
-   if (ctx == NULL)
+   duk_set_top(c, 1);
+   duk_push_current_function(c);                   /* 1 */
+   duk_get_prop_string(c, 1, HB_DUK_P_INDEX);      /* 2 */
+   if (duk_is_undefined(c, 2))
    {
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      return 0;
+   }
+   duk_del_prop_string(c, 1, HB_DUK_P_INDEX);      /* 每個元素只記錄一次 */
+
+   duk_get_prop_string(c, 1, HB_DUK_P_RECORD);     /* 3 [ values, remaining, resolve ] */
+   duk_get_prop_index(c, 3, 0);                    /* 4 */
+   duk_dup(c, 0);
+   duk_put_prop_index(c, 4, duk_get_uint(c, 2));
+   duk_get_prop_index(c, 3, 1);
+   remaining = duk_get_number(c, -1) - 1;
+   duk_pop(c);
+   duk_push_number(c, remaining);
+   duk_put_prop_index(c, 3, 1);
+   if (remaining == 0)
+   {
+      duk_get_prop_index(c, 3, 2);
+      duk_dup(c, 4);
+      duk_call(c, 1);
    }
+   return 0;
+}
 
-   if (code == NULL)
+/* Promise.all (magic 0), Promise.race (magic 1), 接受陣列或類陣列對象 */
+static duk_ret_t hb_duk_promise_combine(duk_context *c)
+{
+   int iMagic = duk_get_current_magic(c);
+   duk_size_t n, nLen;
+
+   duk_set_top(c, 1);
+   duk_push_this(c);                               /* 1 建構函數 */
+   duk_get_prop_string(c, 1, "prototype");         /* 2 */
+   hb_duk_promise_push(c, 2);                      /* 3 結果 */
+   hb_duk_promise_resolvers(c, 3);                 /* 4 resolve, 5 reject */
+   if (!duk_is_object(c, 0))
    {
-      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      duk_dup(c, 5);
+      duk_push_error_object(c, DUK_ERR_TYPE_ERROR, "argument is not array-like");
+      duk_call(c, 1);
+      duk_pop(c);
+      duk_dup(c, 3);
+      return 1;
    }
+   nLen = duk_get_length(c, 0);
 
-   duk_push_string(ctx, code);
-   if (duk_peval(ctx) != 0)
+   duk_push_array(c);                              /* 6 記錄 [ values, remaining, resolve ] */
+   duk_push_array(c);
+   duk_put_prop_index(c, 6, 0);
+   duk_push_number(c, (duk_double_t)nLen);
+   duk_put_prop_index(c, 6, 1);
+   duk_dup(c, 4);
+   duk_put_prop_index(c, 6, 2);
+
+   for (n = 0; n < nLen; n++)
    {
-      error = duk_safe_to_string(ctx, -1);
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      duk_pop(ctx);
-      return;
+      /* C.resolve(item).then(onFulfilled, reject) */
+      duk_push_string(c, "resolve");
+      duk_get_prop_index(c, 0, (duk_uarridx_t)n);
+      duk_call_prop(c, 1, 1);                      /* 7 */
+      duk_push_string(c, "then");
+      if (iMagic == 0)
+      {
+         duk_push_c_function(c, hb_duk_promise_all_fn, 1);
+         duk_push_uint(c, (duk_uint_t)n);
+         duk_put_prop_string(c, -2, HB_DUK_P_INDEX);
+         duk_dup(c, 6);
+         duk_put_prop_string(c, -2, HB_DUK_P_RECORD);
+      }
+      else
+      {
+         duk_dup(c, 4);
+      }
+      duk_dup(c, 5);
+      duk_call_prop(c, 7, 2);
+      duk_pop_2(c);
    }
 
-   result = duk_safe_to_string(ctx, -1);
-   hb_retc(result);
-   duk_pop(ctx);
+   if (iMagic == 0 && nLen == 0)
+   {
+      duk_dup(c, 4);
+      duk_get_prop_index(c, 6, 0);
+      duk_call(c, 1);
+      duk_pop(c);
+   }
+   duk_dup(c, 3);
+   return 1;
 }
 
-/* 執行 JavaScript 文件 */
-HB_FUNC(DUK_EVAL_FILE)
+/* queueMicrotask(fn) */
+static duk_ret_t hb_duk_queue_microtask(duk_context *c)
 {
-   const char *filename = hb_parc(1);
-   const char *error;
-   const char *result;
-   FILE *fp;
-   long size;
-   char *buffer;
+   if (!duk_is_callable(c, 0))
+   {
+      return duk_type_error(c, "callback is not a function");
+   }
+   duk_set_top(c, 1);
+   hb_duk_job_push(c, HB_DUK_JOB_CALLBACK, 1);
+   return 0;
+}
 
-   if (ctx == NULL)
+static void hb_duk_timer_store(duk_context *c, PHB_DUK pDuk)
+{
+   if (pDuk->pTimerStore == NULL)
    {
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      duk_push_heap_stash(c);
+      duk_push_bare_object(c);
+      pDuk->pTimerStore = duk_get_heapptr(c, -1);
+      duk_put_prop_string(c, -2, "hbTimers");
+      duk_pop(c);
    }
+   duk_push_heapptr(c, pDuk->pTimerStore);
+}
 
-   if (filename == NULL)
+static HB_BOOL hb_duk_timer_before(const HB_DUK_TIMER *a, const HB_DUK_TIMER *b)
+{
+   return a->nDue < b->nDue || (a->nDue == b->nDue && a->nSeq < b->nSeq);
+}
+
+/* 加入計時器堆積 (以到期時間排序的二元最小堆積) */
+static void hb_duk_timer_push(PHB_DUK pDuk, HB_MAXUINT nDue, HB_MAXINT nInterval, duk_uarridx_t nId,
+                              PHB_DUK_REALM pRealm)
+{
+   HB_DUK_TIMER t;
+   int i;
+
+   if (pDuk->iTimers == pDuk->iTimerMax)
    {
-      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      pDuk->iTimerMax = pDuk->iTimerMax == 0 ? 16 : pDuk->iTimerMax * 2;
+      pDuk->pTimers = (HB_DUK_TIMER *)hb_xrealloc(pDuk->pTimers, sizeof(HB_DUK_TIMER) * pDuk->iTimerMax);
+   }
+   t.nDue = nDue;
+   t.nSeq = pDuk->nTimerSeq++;
+   t.nInterval = nInterval;
+   t.nId = nId;
+   t.pRealm = pRealm;
+   for (i = pDuk->iTimers++; i > 0; )
+   {
+      int iParent = (i - 1) / 2;
+
+      if (!hb_duk_timer_before(&t, &pDuk->pTimers[iParent]))
+      {
+         break;
+      }
+      pDuk->pTimers[i] = pDuk->pTimers[iParent];
+      i = iParent;
    }
+   pDuk->pTimers[i] = t;
+}
 
-   fp = fopen(filename, "rb");
-   if (fp == NULL)
+/* 移除最早到期的計時器 */
+static void hb_duk_timer_pop(PHB_DUK pDuk)
+{
+   HB_DUK_TIMER *p = pDuk->pTimers;
+   HB_DUK_TIMER t = p[--pDuk->iTimers];
+   int i = 0;
+
+   if (pDuk->iTimers == 0)
    {
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
+   for (;;)
+   {
+      int iChild = 2 * i + 1;
+
+      if (iChild >= pDuk->iTimers)
+      {
+         break;
+      }
+      if (iChild + 1 < pDuk->iTimers && hb_duk_timer_before(&p[iChild + 1], &p[iChild]))
+      {
+         iChild++;
+      }
+      if (!hb_duk_timer_before(&p[iChild], &t))
+      {
+         break;
+      }
+      p[i] = p[iChild];
+      i = iChild;
+   }
+   p[i] = t;
+}
 
-   fseek(fp, 0, SEEK_END);
-   size = ftell(fp);
-   fseek(fp, 0, SEEK_SET);
+/* setTimeout(fn, ms, ...args) (magic 0), setInterval(fn, ms, ...args) (magic 1) */
+static duk_ret_t hb_duk_set_timer(duk_context *c)
+{
+   PHB_DUK pDuk = hb_duk_from_ctx(c);
+   duk_idx_t nArgs = duk_get_top(c), i;
+   HB_MAXINT nDelay = 0;
+   duk_uarridx_t nId;
 
-   buffer = (char *)hb_xalloc(size + 1);
-   if (buffer == NULL)
+   if (!duk_is_callable(c, 0))
+   {
+      return duk_type_error(c, "callback is not a function");
+   }
+   if (nArgs > 1)
+   {
+      nDelay = duk_to_int(c, 1);
+      if (nDelay < 0)
+      {
+         nDelay = 0;
+      }
+   }
+
+   /* 計時器編號 -> [fn, 參數...] */
+   duk_push_array(c);
+   duk_dup(c, 0);
+   duk_put_prop_index(c, -2, 0);
+   for (i = 2; i < nArgs; i++)
+   {
+      duk_dup(c, i);
+      duk_put_prop_index(c, -2, (duk_uarridx_t)(i - 1));
+   }
+   nId = ++pDuk->nTimerId;
+   hb_duk_timer_store(c, pDuk);
+   duk_swap_top(c, -2);
+   duk_put_prop_index(c, -2, nId);
+   duk_pop(c);
+
+   /* 間隔至少 1 毫秒, 避免在同一次 DUK_RUN_JOBS 中無限重複 */
+   hb_duk_timer_push(pDuk, hb_duk_clock_us() + (HB_MAXUINT)nDelay * 1000,
+                     duk_get_current_magic(c) != 0 ? (nDelay > 0 ? nDelay : 1) : -1, nId, pDuk->pRealm);
+   duk_push_uint(c, nId);
+   return 1;
+}
+
+/* clearTimeout(id), clearInterval(id): 堆積中的項目留待到期時略過 */
+static duk_ret_t hb_duk_clear_timer(duk_context *c)
+{
+   PHB_DUK pDuk = hb_duk_from_ctx(c);
+
+   if (duk_is_number(c, 0) && pDuk->pTimerStore != NULL)
+   {
+      duk_push_heapptr(c, pDuk->pTimerStore);
+      duk_dup(c, 0);
+      duk_del_prop(c, -2);
+   }
+   return 0;
+}
+
+/* 執行一個工作, 工作陣列在堆疊頂端 */
+static duk_ret_t hb_duk_job_run(duk_context *c, void *udata)
+{
+   duk_idx_t job = duk_get_top_index(c);
+   int iState;
+
+   (void)udata;
+   duk_get_prop_index(c, job, 0);
+   switch (duk_get_int(c, -1))
+   {
+      case HB_DUK_JOB_REACTION:
+         duk_get_prop_index(c, job, 1);            /* job + 2 衍生 promise */
+         duk_get_prop_index(c, job, 2);
+         if (duk_is_callable(c, -1))
+         {
+            duk_get_prop_index(c, job, 3);
+            iState = duk_pcall(c, 1) == DUK_EXEC_SUCCESS ? 1 : 2;
+         }
+         else
+         {
+            duk_pop(c);
+            duk_get_prop_index(c, job, 3);
+            duk_get_prop_index(c, job, 4);
+            iState = duk_get_int(c, -1);
+            duk_pop(c);
+         }
+         if (hb_duk_is_promise(c, job + 2))
+         {
+            if (iState == 1)
+               hb_duk_promise_resolve(c, job + 2);
+            else
+               hb_duk_promise_settle(c, job + 2, 2);
+         }
+         break;
+
+      case HB_DUK_JOB_THENABLE:
+         duk_get_prop_index(c, job, 1);            /* job + 2 */
+         hb_duk_promise_resolvers(c, job + 2);     /* job + 3 resolve, job + 4 reject */
+         duk_get_prop_index(c, job, 3);
+         duk_get_prop_index(c, job, 2);
+         duk_dup(c, job + 3);
+         duk_dup(c, job + 4);
+         if (duk_pcall_method(c, 2) != DUK_EXEC_SUCCESS)
+         {
+            duk_dup(c, job + 4);
+            duk_swap_top(c, -2);
+            duk_call(c, 1);
+         }
+         break;
+
+      case HB_DUK_JOB_CALLBACK:
+         duk_get_prop_index(c, job, 1);
+         duk_call(c, 0);                           /* 錯誤傳回 DUK_RUN_JOBS */
+         break;
+   }
+   return 0;
+}
+
+/* 觸發計時器, [fn, 參數...] 在堆疊頂端 */
+static duk_ret_t hb_duk_timer_fire(duk_context *c, void *udata)
+{
+   duk_idx_t entry = duk_get_top_index(c);
+   duk_size_t n, nLen = duk_get_length(c, entry);
+
+   (void)udata;
+   duk_require_stack(c, (duk_idx_t)nLen + 2);
+   duk_get_prop_index(c, entry, 0);
+   duk_push_undefined(c);
+   for (n = 1; n < nLen; n++)
+   {
+      duk_get_prop_index(c, entry, (duk_uarridx_t)n);
+   }
+   duk_call_method(c, (duk_idx_t)nLen - 1);
+   return 0;
+}
+
+/* 執行下一個工作或 nNow 前到期的計時器: 返回 0 無事可做, 1 成功, -1 失敗 (錯誤在 c 的堆疊頂端)
+ * 工作在排入時的 realm 執行緒上執行, 受該 realm 的逾時與記憶體預算限制 */
+static int hb_duk_jobs_step(PHB_DUK pDuk, duk_context *c, HB_MAXUINT nNow)
+{
+   HB_DUK_EXEC exec;
+   PHB_DUK_REALM pRealm;
+   duk_safe_call_function fnRun;
+   duk_context *cRun;
+   duk_int_t rc;
+
+   if (pDuk->nJobHead < pDuk->nJobTail)
+   {
+      pRealm = pDuk->pJobRealm[pDuk->nJobHead];
+      duk_push_heapptr(c, pDuk->pJobStore);
+      duk_get_prop_index(c, -1, pDuk->nJobHead);
+      duk_del_prop_index(c, -2, pDuk->nJobHead);
+      duk_remove(c, -2);
+      if (++pDuk->nJobHead == pDuk->nJobTail)
+      {
+         pDuk->nJobHead = pDuk->nJobTail = 0;
+      }
+      fnRun = hb_duk_job_run;
+   }
+   else if (pDuk->iTimers > 0 && pDuk->pTimers[0].nDue <= nNow)
+   {
+      HB_DUK_TIMER t = pDuk->pTimers[0];
+
+      hb_duk_timer_pop(pDuk);
+      duk_push_heapptr(c, pDuk->pTimerStore);
+      duk_get_prop_index(c, -1, t.nId);
+      if (duk_is_undefined(c, -1))
+      {
+         duk_pop_2(c);   /* 已清除 */
+         return 1;
+      }
+      /* 先重新排程, 回調中的 clearInterval 才能生效 */
+      if (t.nInterval >= 0 && t.pRealm != &s_realmGone)
+      {
+         hb_duk_timer_push(pDuk, hb_duk_clock_us() + (HB_MAXUINT)t.nInterval * 1000, t.nInterval, t.nId, t.pRealm);
+      }
+      else
+      {
+         duk_del_prop_index(c, -2, t.nId);
+      }
+      duk_remove(c, -2);
+      pRealm = t.pRealm;
+      fnRun = hb_duk_timer_fire;
+   }
+   else
+   {
+      return 0;
+   }
+
+   /* 排入工作的 realm 已被回收 */
+   if (pRealm == &s_realmGone)
+   {
+      duk_pop(c);
+      return 1;
+   }
+
+   cRun = c;
+   if (pRealm != NULL)
+   {
+      /* 執行期間保留 realm, 回調中的 Harbour GC 不會將其回收 */
+      hb_gcRefInc(pRealm);
+      cRun = pRealm->ctx;
+      duk_xmove_top(cRun, c, 1);
+   }
+   hb_duk_exec_begin(pDuk, pRealm, 0, &exec);
+   rc = duk_safe_call(cRun, fnRun, NULL, 1, 1);
+   hb_duk_exec_end(pDuk, &exec);
+   if (pRealm != NULL)
+   {
+      duk_xmove_top(c, cRun, 1);
+      hb_gcRefFree(pRealm);
+   }
+
+   if (rc != DUK_EXEC_SUCCESS)
+   {
+      return -1;
+   }
+   duk_pop(c);
+   return 1;
+}
+
+static void hb_duk_def_func(duk_context *c, duk_idx_t objidx, const char *name, duk_c_function fn, duk_idx_t nargs, duk_int_t magic)
+{
+   objidx = duk_normalize_index(c, objidx);
+   duk_push_string(c, name);
+   duk_push_c_function(c, fn, nargs);
+   duk_set_magic(c, -1, magic);
+   duk_def_prop(c, objidx, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_SET_WRITABLE |
+                           DUK_DEFPROP_CLEAR_ENUMERABLE | DUK_DEFPROP_SET_CONFIGURABLE);
+}
+
+/* 在 c 的全局環境安裝 Promise, setTimeout, taskYield 等, 屬性與內建對象相同為不可列舉 */
+static void hb_duk_async_install(duk_context *c)
+{
+   duk_push_global_object(c);
+   duk_push_string(c, "Promise");
+   duk_push_c_function(c, hb_duk_promise_ctor, 1);
+
+   duk_push_string(c, "prototype");
+   duk_push_object(c);
+   hb_duk_def_func(c, -1, "then", hb_duk_promise_then, 2, 0);
+   hb_duk_def_func(c, -1, "catch", hb_duk_promise_catch, 1, 0);
+   hb_duk_def_func(c, -1, "finally", hb_duk_promise_finally, 1, 0);
+   duk_push_string(c, "constructor");
+   duk_dup(c, -4);
+   duk_def_prop(c, -3, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_SET_WRITABLE |
+                       DUK_DEFPROP_CLEAR_ENUMERABLE | DUK_DEFPROP_SET_CONFIGURABLE);
+   duk_def_prop(c, -3, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_CLEAR_WEC);
+
+   hb_duk_def_func(c, -1, "resolve", hb_duk_promise_static, 1, 0);
+   hb_duk_def_func(c, -1, "reject", hb_duk_promise_static, 1, 1);
+   hb_duk_def_func(c, -1, "all", hb_duk_promise_combine, 1, 0);
+   hb_duk_def_func(c, -1, "race", hb_duk_promise_combine, 1, 1);
+   duk_def_prop(c, -3, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_SET_WRITABLE |
+                       DUK_DEFPROP_CLEAR_ENUMERABLE | DUK_DEFPROP_SET_CONFIGURABLE);
+
+   hb_duk_def_func(c, -1, "setTimeout", hb_duk_set_timer, DUK_VARARGS, 0);
+   hb_duk_def_func(c, -1, "setInterval", hb_duk_set_timer, DUK_VARARGS, 1);
+   hb_duk_def_func(c, -1, "clearTimeout", hb_duk_clear_timer, 1, 0);
+   hb_duk_def_func(c, -1, "clearInterval", hb_duk_clear_timer, 1, 0);
+   hb_duk_def_func(c, -1, "queueMicrotask", hb_duk_queue_microtask, 1, 0);
+   hb_duk_def_func(c, -1, "taskYield", hb_duk_task_yield_fn, 0, 0);
+   duk_pop(c);
+}
+
+/* 執行待處理的工作及已到期的計時器: DUK_RUN_JOBS([hHeap,] [nMaxMs], [@aErrors])
+ * nMaxMs > 0 時超過該時間即返回 (單一工作仍受 DUK_SET_TIMEOUT 限制).
+ * 返回 0 表示尚有工作, 否則為距下一個計時器的毫秒數, 無待處理項目時為 -1.
+ * 未傳入 aErrors 時第一個未捕獲的錯誤會停止執行並引發錯誤 */
+HB_FUNC(DUK_RUN_JOBS)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx = pDuk != NULL ? pDuk->ctx : NULL;
+   HB_MAXINT nMaxMs = hb_parnint(iBase + 1);
+   PHB_ITEM pErrors;
+   HB_MAXUINT nNow, nStop;
+   HB_BOOL fError = HB_FALSE;
+   int iStep;
+
+   if (ctx == NULL)
    {
-      fclose(fp);
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   fread(buffer, 1, size, fp);
-   buffer[size] = '\0';
-   fclose(fp);
+   pErrors = HB_ISBYREF(iBase + 2) ? hb_itemArrayNew(0) : NULL;
+   nNow = hb_duk_clock_us();
+   nStop = nMaxMs > 0 ? nNow + (HB_MAXUINT)nMaxMs * 1000 : 0;
 
-   duk_push_string(ctx, buffer);
-   hb_xfree(buffer);
+   /* 只執行開始時已到期的計時器, 回調新加入的不會在本次執行 */
+   while ((iStep = hb_duk_jobs_step(pDuk, ctx, nNow)) != 0)
+   {
+      if (iStep < 0)
+      {
+         if (pErrors == NULL)
+         {
+            duk_pop(ctx);
+            fError = HB_TRUE;
+            break;
+         }
+         else
+         {
+            duk_size_t len;
+            const char *msg = duk_safe_to_lstring(ctx, -1, &len);
+            HB_SIZE nIndex = hb_arrayLen(pErrors) + 1;
+
+            hb_arraySize(pErrors, nIndex);
+            hb_arraySetCL(pErrors, nIndex, msg, (HB_SIZE)len);
+            duk_pop(ctx);
+         }
+      }
+      if (nStop != 0 && hb_duk_clock_us() >= nStop)
+      {
+         break;
+      }
+   }
 
-   if (duk_peval(ctx) != 0)
+   if (pErrors != NULL)
+   {
+      hb_itemParamStoreRelease(iBase + 2, pErrors);
+   }
+   if (fError)
    {
-      error = duk_safe_to_string(ctx, -1);
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      duk_pop(ctx);
       return;
    }
 
-   result = duk_safe_to_string(ctx, -1);
-   hb_retc(result);
-   duk_pop(ctx);
+   if (pDuk->nJobHead < pDuk->nJobTail)
+   {
+      hb_retni(0);
+   }
+   else if (pDuk->iTimers > 0)
+   {
+      nNow = hb_duk_clock_us();
+      hb_retnint(pDuk->pTimers[0].nDue <= nNow ? 0 : (HB_MAXINT)((pDuk->pTimers[0].nDue - nNow + 999) / 1000));
+   }
+   else
+   {
+      hb_retni(-1);
+   }
 }
 
-/* 創建新的 JavaScript 對象 */
-HB_FUNC(DUK_PUSH_OBJECT)
+/* 直接銷毀 Duktape 堆 */
+HB_FUNC(DUK_DESTROY_HEAP)
 {
-   if (ctx == NULL)
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+
+   if (pDuk != NULL)
    {
-      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      hb_duk_destroy(pDuk);
    }
+   hb_retl(HB_TRUE);
+}
 
-   duk_push_object(ctx);
-   hb_retni(duk_get_top_index(ctx));
+/* 清理 Duktape 引擎 */
+HB_FUNC(DUK_CLEANUP)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+
+   if (pDuk != NULL)
+   {
+      hb_duk_destroy(pDuk);
+   }
+   hb_retl(HB_TRUE);
 }
 
-/* 設置對象屬性 */
-HB_FUNC(DUK_PUT_PROP_STRING)
+/* 註冊 Harbour 函數到 JavaScript 環境 */
+HB_FUNC(DUK_REGISTER_FUNCTION)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   const char *key = hb_parc(2);
-   const char *value = hb_parc(3);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
+   PHB_ITEM pFunc = hb_param(iBase + 2, HB_IT_EVALITEM);   /* 代碼塊或 @Func() */
+   PHB_DUK pDuk;
 
    if (ctx == NULL)
    {
@@ -195,22 +6330,43 @@ HB_FUNC(DUK_PUT_PROP_STRING)
       return;
    }
 
-   if (key == NULL || value == NULL)
+   if (name == NULL)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (pFunc == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_push_string(ctx, value);
-   duk_put_prop_string(ctx, obj_idx, key);
+   pDuk = hb_duk_from_ctx(ctx);
+   if (pDuk->iCallbacks >= HB_DUK_MAX_CALLBACKS)
+   {
+      hb_errRT_BASE(EG_LIMIT, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   /* hb_itemNew 的副本受 Harbour GC 保護, heap 銷毀時釋放 */
+   pDuk->pCallbacks = (PHB_ITEM *)hb_xrealloc(pDuk->pCallbacks, sizeof(PHB_ITEM) * (pDuk->iCallbacks + 1));
+   pDuk->pCallbacks[pDuk->iCallbacks] = hb_itemNew(pFunc);
+   pDuk->pCallbackNames = (char **)hb_xrealloc(pDuk->pCallbackNames, sizeof(char *) * (pDuk->iCallbacks + 1));
+   pDuk->pCallbackNames[pDuk->iCallbacks] = hb_strdup(name);
+
+   duk_push_c_function(ctx, hb_duk_trampoline, DUK_VARARGS);
+   duk_set_magic(ctx, -1, pDuk->iCallbacks++);
+   duk_put_global_lstring(ctx, name, hb_parclen(iBase + 1));
    hb_retl(HB_TRUE);
 }
 
-/* 獲取對象屬性 */
-HB_FUNC(DUK_GET_PROP_STRING)
+/* 從 JavaScript 環境獲取變量值 */
+HB_FUNC(DUK_GET_VAR)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   const char *key = hb_parc(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
 
    if (ctx == NULL)
    {
@@ -218,16 +6374,16 @@ HB_FUNC(DUK_GET_PROP_STRING)
       return;
    }
 
-   if (key == NULL)
+   if (name == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_get_prop_string(ctx, obj_idx, key);
+   duk_get_global_lstring(ctx, name, hb_parclen(iBase + 1));
    if (duk_is_string(ctx, -1))
    {
-      hb_retc(duk_get_string(ctx, -1));
+      hb_duk_retstr(ctx, -1);
    }
    else if (duk_is_number(ctx, -1))
    {
@@ -239,18 +6395,17 @@ HB_FUNC(DUK_GET_PROP_STRING)
    }
    else
    {
-      hb_retc(duk_safe_to_string(ctx, -1));
+      hb_duk_retstr(ctx, -1);
    }
    duk_pop(ctx);
 }
 
-/* 調用 JavaScript 函數 */
-HB_FUNC(DUK_CALL_FUNCTION)
+/* 設置 JavaScript 環境變量值 */
+HB_FUNC(DUK_SET_VAR)
 {
-   const char *func_name = hb_parc(1);
-   duk_int_t nargs = hb_parni(2);
-   const char *error;
-   const char *result;
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
 
    if (ctx == NULL)
    {
@@ -258,60 +6413,54 @@ HB_FUNC(DUK_CALL_FUNCTION)
       return;
    }
 
-   if (func_name == NULL)
-   {
-      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
-   }
-
-   duk_get_global_string(ctx, func_name);
-   if (!duk_is_function(ctx, -1))
+   if (name == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      duk_pop(ctx);
       return;
    }
 
-   if (duk_pcall(ctx, nargs) != 0)
+   if (HB_ISNIL(iBase + 2))
+   {
+      duk_push_undefined(ctx);
+   }
+   else if (!hb_duk_push_item_safe(ctx, hb_param(iBase + 2, HB_IT_ANY)))
    {
-      error = duk_safe_to_string(ctx, -1);
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       duk_pop(ctx);
       return;
    }
 
-   result = duk_safe_to_string(ctx, -1);
-   hb_retc(result);
-   duk_pop(ctx);
+   duk_put_global_lstring(ctx, name, hb_parclen(iBase + 1));
+   hb_retl(HB_TRUE);
 }
 
-/* 直接銷毀 Duktape 堆 */
-HB_FUNC(DUK_DESTROY_HEAP)
+/* 將 Harbour 值 (含陣列, 雜湊, 日期) 直接推入堆疊, 返回索引 */
+HB_FUNC(DUK_PUSH_VALUE)
 {
-   if (ctx != NULL)
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   if (ctx == NULL)
    {
-      duk_destroy_heap(ctx);
-      ctx = NULL;
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
    }
-   hb_retl(HB_TRUE);
-}
 
-/* 清理 Duktape 引擎 */
-HB_FUNC(DUK_CLEANUP)
-{
-   if (ctx != NULL)
+   if (!hb_duk_push_item_safe(ctx, hb_param(iBase + 1, HB_IT_ANY)))
    {
-      duk_destroy_heap(ctx);
-      ctx = NULL;
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+      return;
    }
-   hb_retl(HB_TRUE);
+   hb_retni(duk_get_top_index(ctx));
 }
 
-/* 註冊 Harbour 函數到 JavaScript 環境 */
-HB_FUNC(DUK_REGISTER_FUNCTION)
+/* 將堆疊中的值轉換為 Harbour 值 (陣列轉為陣列, 對象轉為雜湊) */
+HB_FUNC(DUK_GET_VALUE)
 {
-   const char *name = hb_parc(1);
-   PHB_ITEM pFunc = hb_param(2, HB_IT_BLOCK);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   duk_idx_t idx = HB_ISNUM(iBase + 1) ? hb_parni(iBase + 1) : -1;
 
    if (ctx == NULL)
    {
@@ -319,27 +6468,34 @@ HB_FUNC(DUK_REGISTER_FUNCTION)
       return;
    }
 
-   if (name == NULL)
+   if (!duk_is_valid_index(ctx, idx))
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   if (pFunc == NULL)
+   if (!hb_duk_get_item_safe(ctx, idx, hb_stackReturnItem()))
    {
-      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
-      return;
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
    }
-
-   duk_push_c_function(ctx, (duk_c_function)hb_itemGetPtr(pFunc), DUK_VARARGS);
-   duk_put_global_string(ctx, name);
-   hb_retl(HB_TRUE);
 }
 
-/* 從 JavaScript 環境獲取變量值 */
-HB_FUNC(DUK_GET_VAR)
+/* 以 Uint8Array 直接引用 Harbour 字串記憶體 (不複製):
+ * DUK_PUSH_BUFFER_VIEW([hHeap,] cData, [cGlobal], [lWritable])
+ * 未指定 cGlobal 時推入堆疊並返回索引, 否則存為全局變量後彈出並返回 .T.
+ * 字串在緩衝區存活期間保持釘選. 預設與 Harbour 共用記憶體 (不複製): JavaScript 的寫入
+ * 會直接改變該字串緩衝區, 所有共用同一緩衝區的 Harbour 變量 (如 c2 := cData) 都會看到.
+ * 靜態字串 (程式中的字串常量, 單字元字串) 不可寫入, 此時仍會先複製一份.
+ * lWritable 為 .T. 時一律改用私有副本, 原字串不受影響, 寫入結果以 DUK_GET_BUFFER 取回 */
+HB_FUNC(DUK_PUSH_BUFFER_VIEW)
 {
-   const char *name = hb_parc(1);
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   duk_context *ctx = hb_duk_param_ctx(pDuk, hb_duk_realm_param());
+   PHB_ITEM pData = hb_param(iBase + 1, HB_IT_STRING);
+   const char *name = hb_parc(iBase + 2);
+   HB_SIZE len;
 
    if (ctx == NULL)
    {
@@ -347,36 +6503,50 @@ HB_FUNC(DUK_GET_VAR)
       return;
    }
 
-   if (name == NULL)
+   if (pData == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_get_global_string(ctx, name);
-   if (duk_is_string(ctx, -1))
-   {
-      hb_retc(duk_get_string(ctx, -1));
-   }
-   else if (duk_is_number(ctx, -1))
+   len = hb_itemGetCLen(pData);
+   duk_push_external_buffer(ctx);
+   if (len > 0)
    {
-      hb_retnd(duk_get_number(ctx, -1));
+      PHB_ITEM pPin = hb_duk_pin_item(pDuk, pData);
+
+      /* 靜態字串位於唯讀記憶體, 共用後一旦寫入即崩潰 */
+      if (hb_parl(iBase + 3) || pPin->item.asString.allocated == 0)
+      {
+         hb_itemUnShare(pPin);
+      }
+      /* 之後若配置失敗, 緩衝區釋放時由 hb_duk_extbuf_free 解除釘選 */
+      duk_config_buffer(ctx, -1, (void *)hb_itemGetCPtr(pPin), (duk_size_t)len);
    }
-   else if (duk_is_boolean(ctx, -1))
+   duk_push_buffer_object(ctx, -1, 0, (duk_size_t)len, DUK_BUFOBJ_UINT8ARRAY);
+   duk_remove(ctx, -2);
+
+   if (name != NULL)
    {
-      hb_retl(duk_get_boolean(ctx, -1));
+      duk_put_global_lstring(ctx, name, hb_parclen(iBase + 2));
+      hb_retl(HB_TRUE);
    }
    else
    {
-      hb_retc(duk_safe_to_string(ctx, -1));
+      hb_retni(duk_get_top_index(ctx));
    }
-   duk_pop(ctx);
 }
 
-/* 設置 JavaScript 環境變量值 */
-HB_FUNC(DUK_SET_VAR)
+/* 返回緩衝區或緩衝區視圖 (ArrayBuffer, TypedArray, DataView) 的位元組, 不經 base64:
+ * DUK_GET_BUFFER([hHeap,] [nIndex | cGlobal]), 預設為堆疊頂端 */
+HB_FUNC(DUK_GET_BUFFER)
 {
-   const char *name = hb_parc(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
+   duk_idx_t idx = HB_ISNUM(iBase + 1) ? hb_parni(iBase + 1) : -1;
+   duk_size_t len;
+   void *data;
 
    if (ctx == NULL)
    {
@@ -384,36 +6554,69 @@ HB_FUNC(DUK_SET_VAR)
       return;
    }
 
-   if (name == NULL)
+   if (name != NULL)
+   {
+      duk_get_global_lstring(ctx, name, hb_parclen(iBase + 1));
+      idx = -1;
+   }
+   else if (!duk_is_valid_index(ctx, idx))
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   if (HB_ISCHAR(2))
+   if (!duk_is_buffer_data(ctx, idx))
    {
-      duk_push_string(ctx, hb_parc(2));
+      if (name != NULL)
+      {
+         duk_pop(ctx);
+      }
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
    }
-   else if (HB_ISNUM(2))
+
+   data = duk_get_buffer_data(ctx, idx, &len);
+   hb_retclen((const char *)data, (HB_SIZE)len);
+   if (name != NULL)
    {
-      duk_push_number(ctx, hb_parnd(2));
+      duk_pop(ctx);
    }
-   else if (HB_ISLOG(2))
+}
+
+/* 以 Harbour 值獲取 JavaScript 全局變量 */
+HB_FUNC(DUK_GET_VAR_VALUE)
+{
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
+
+   if (ctx == NULL)
    {
-      duk_push_boolean(ctx, hb_parl(2));
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
    }
-   else
+
+   if (name == NULL)
    {
-      duk_push_undefined(ctx);
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
    }
 
-   duk_put_global_string(ctx, name);
-   hb_retl(HB_TRUE);
+   duk_get_global_lstring(ctx, name, hb_parclen(iBase + 1));
+   if (!hb_duk_get_item_safe(ctx, -1, hb_stackReturnItem()))
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      duk_pop(ctx);
+   }
+   duk_pop(ctx);
 }
 
 /* 創建新的 JavaScript 數組 */
 HB_FUNC(DUK_PUSH_ARRAY)
 {
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
    if (ctx == NULL)
    {
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
@@ -427,8 +6630,11 @@ HB_FUNC(DUK_PUSH_ARRAY)
 /* 設置數組元素 */
 HB_FUNC(DUK_PUT_ARRAY_ELEMENT)
 {
-   duk_idx_t arr_idx = hb_parni(1);
-   duk_uarridx_t index = (duk_uarridx_t)hb_parni(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t arr_idx = hb_parni(iBase + 1);
+   duk_uarridx_t index = (duk_uarridx_t)hb_parni(iBase + 2);
 
    if (ctx == NULL)
    {
@@ -436,17 +6642,17 @@ HB_FUNC(DUK_PUT_ARRAY_ELEMENT)
       return;
    }
 
-   if (HB_ISCHAR(3))
+   if (HB_ISCHAR(iBase + 3))
    {
-      duk_push_string(ctx, hb_parc(3));
+      hb_duk_push_string_item(ctx, hb_param(iBase + 3, HB_IT_STRING));
    }
-   else if (HB_ISNUM(3))
+   else if (HB_ISNUM(iBase + 3))
    {
-      duk_push_number(ctx, hb_parnd(3));
+      duk_push_number(ctx, hb_parnd(iBase + 3));
    }
-   else if (HB_ISLOG(3))
+   else if (HB_ISLOG(iBase + 3))
    {
-      duk_push_boolean(ctx, hb_parl(3));
+      duk_push_boolean(ctx, hb_parl(iBase + 3));
    }
    else
    {
@@ -460,8 +6666,11 @@ HB_FUNC(DUK_PUT_ARRAY_ELEMENT)
 /* 獲取數組元素 */
 HB_FUNC(DUK_GET_ARRAY_ELEMENT)
 {
-   duk_idx_t arr_idx = hb_parni(1);
-   duk_uarridx_t index = (duk_uarridx_t)hb_parni(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t arr_idx = hb_parni(iBase + 1);
+   duk_uarridx_t index = (duk_uarridx_t)hb_parni(iBase + 2);
 
    if (ctx == NULL)
    {
@@ -472,7 +6681,7 @@ HB_FUNC(DUK_GET_ARRAY_ELEMENT)
    duk_get_prop_index(ctx, arr_idx, index);
    if (duk_is_string(ctx, -1))
    {
-      hb_retc(duk_get_string(ctx, -1));
+      hb_duk_retstr(ctx, -1);
    }
    else if (duk_is_number(ctx, -1))
    {
@@ -484,7 +6693,7 @@ HB_FUNC(DUK_GET_ARRAY_ELEMENT)
    }
    else
    {
-      hb_retc(duk_safe_to_string(ctx, -1));
+      hb_duk_retstr(ctx, -1);
    }
    duk_pop(ctx);
 }
@@ -492,7 +6701,10 @@ HB_FUNC(DUK_GET_ARRAY_ELEMENT)
 /* 獲取數組長度 */
 HB_FUNC(DUK_GET_ARRAY_LENGTH)
 {
-   duk_idx_t arr_idx = hb_parni(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t arr_idx = hb_parni(iBase + 1);
    duk_size_t len;
 
    if (ctx == NULL)
@@ -508,8 +6720,11 @@ HB_FUNC(DUK_GET_ARRAY_LENGTH)
 /* 檢查值類型 */
 HB_FUNC(DUK_CHECK_TYPE)
 {
-   duk_idx_t idx = hb_parni(1);
-   const char *type = hb_parc(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t idx = hb_parni(iBase + 1);
+   const char *type = hb_parc(iBase + 2);
    HB_BOOL result = HB_FALSE;
 
    if (ctx == NULL)
@@ -563,8 +6778,10 @@ HB_FUNC(DUK_CHECK_TYPE)
 /* 將 JavaScript 值轉換為 JSON 字符串 */
 HB_FUNC(DUK_JSON_STRINGIFY)
 {
-   duk_idx_t idx = hb_parni(1);
-   const char *json;
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t idx = hb_parni(iBase + 1);
 
    if (ctx == NULL)
    {
@@ -573,15 +6790,16 @@ HB_FUNC(DUK_JSON_STRINGIFY)
    }
 
    duk_json_encode(ctx, idx);
-   json = duk_get_string(ctx, -1);
-   hb_retc(json);
+   hb_duk_retstr(ctx, -1);
    duk_pop(ctx);
 }
 
 /* 將 JSON 字符串解析為 JavaScript 值 */
 HB_FUNC(DUK_JSON_PARSE)
 {
-   const char *json = hb_parc(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *json = hb_parc(iBase + 1);
    const char *error;
 
    if (ctx == NULL)
@@ -596,7 +6814,7 @@ HB_FUNC(DUK_JSON_PARSE)
       return;
    }
 
-   duk_push_string(ctx, json);
+   duk_push_lstring(ctx, json, hb_parclen(iBase + 1));
    duk_json_decode(ctx, -1);
 
    hb_retni(duk_get_top_index(ctx));
@@ -605,7 +6823,9 @@ HB_FUNC(DUK_JSON_PARSE)
 /* 設置錯誤處理器 */
 HB_FUNC(DUK_SET_ERROR_HANDLER)
 {
-   const char *handler = hb_parc(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *handler = hb_parc(iBase + 1);
    const char *error;
 
    if (ctx == NULL)
@@ -620,7 +6840,7 @@ HB_FUNC(DUK_SET_ERROR_HANDLER)
       return;
    }
 
-   duk_push_string(ctx, handler);
+   duk_push_lstring(ctx, handler, hb_parclen(iBase + 1));
    if (duk_peval(ctx) != 0)
    {
       error = duk_safe_to_string(ctx, -1);
@@ -633,30 +6853,118 @@ HB_FUNC(DUK_SET_ERROR_HANDLER)
    hb_retl(HB_TRUE);
 }
 
-/* 設置記憶體限制 */
+/* 設置 heap 預設執行逾時 (毫秒), 0 為不限; 未指定逾時參數的執行皆受此限制 */
+HB_FUNC(DUK_SET_TIMEOUT)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (!HB_ISNUM(iBase + 1) || hb_parnint(iBase + 1) < 0)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pDuk->nTimeout = hb_parnint(iBase + 1);
+   hb_retl(HB_TRUE);
+}
+
+/* 取消 heap 上正在執行的腳本, 可由其他執行緒調用; 返回該 heap 是否正在執行 */
+HB_FUNC(DUK_CANCEL)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_retl(HB_FALSE);
+      return;
+   }
+
+   if (pDuk->iExecDepth > 0)
+   {
+      pDuk->fCancel = 1;
+      hb_retl(HB_TRUE);
+   }
+   else
+   {
+      hb_retl(HB_FALSE);
+   }
+}
+
+/* 設置記憶體限制 (位元組), 0 為不限; 超限的配置在 JavaScript 中拋出 RangeError */
 HB_FUNC(DUK_SET_MEMORY_LIMIT)
 {
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (!HB_ISNUM(iBase + 1) || hb_parnd(iBase + 1) < 0)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pDuk->nMemLimit = (duk_size_t)hb_parnint(iBase + 1);
    hb_retl(HB_TRUE);
 }
 
-/* 獲取記憶體使用情況 */
-HB_FUNC(DUK_GET_MEMORY_INFO)
+/* 設置外部字串門檻 (位元組), 不短於此的 Harbour 字串由 Duktape 直接引用而不複製;
+ * 0 為停用. 需以 HB_DUK_EXTSTR 編譯, 否則返回 .F. 且不生效 */
+HB_FUNC(DUK_EXTERNAL_STRINGS)
 {
-   duk_memory_functions funcs;
-   PHB_ITEM pArray = hb_itemArrayNew(4);
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
 
-   if (ctx == NULL)
+   if (pDuk == NULL || pDuk->ctx == NULL)
    {
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_get_memory_functions(ctx, &funcs);
+   if (!HB_ISNUM(iBase + 1) || hb_parnd(iBase + 1) < 0)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+#if defined(DUK_USE_HSTRING_EXTDATA)
+   pDuk->nExtMin = (HB_SIZE)hb_parnint(iBase + 1);
+   hb_retl(HB_TRUE);
+#else
+   hb_retl(HB_FALSE);
+#endif
+}
+
+/* 獲取記憶體使用情況: { 目前位元組, 峰值位元組, 上限, slab 保留位元組 } */
+HB_FUNC(DUK_GET_MEMORY_INFO)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_ITEM pArray;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
 
-   hb_arraySetNInt(pArray, 1, (HB_PTRUINT)funcs.alloc_func);
-   hb_arraySetNInt(pArray, 2, (HB_PTRUINT)funcs.realloc_func);
-   hb_arraySetNInt(pArray, 3, (HB_PTRUINT)funcs.free_func);
-   hb_arraySetNInt(pArray, 4, (HB_PTRUINT)funcs.udata);
+   pArray = hb_itemArrayNew(4);
+   hb_arraySetNInt(pArray, 1, (HB_MAXINT)pDuk->nMemLive);
+   hb_arraySetNInt(pArray, 2, (HB_MAXINT)pDuk->nMemPeak);
+   hb_arraySetNInt(pArray, 3, (HB_MAXINT)pDuk->nMemLimit);
+   hb_arraySetNInt(pArray, 4, (HB_MAXINT)pDuk->slab.nSlabs * HB_DUK_SLAB_SIZE);
 
    hb_itemReturn(pArray);
    hb_itemRelease(pArray);
@@ -665,8 +6973,11 @@ HB_FUNC(DUK_GET_MEMORY_INFO)
 /* 設置對象原型 */
 HB_FUNC(DUK_SET_PROTOTYPE)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   duk_idx_t proto_idx = hb_parni(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   duk_idx_t proto_idx = hb_parni(iBase + 2);
 
    if (ctx == NULL)
    {
@@ -681,7 +6992,10 @@ HB_FUNC(DUK_SET_PROTOTYPE)
 /* 獲取對象原型 */
 HB_FUNC(DUK_GET_PROTOTYPE)
 {
-   duk_idx_t obj_idx = hb_parni(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
 
    if (ctx == NULL)
    {
@@ -702,9 +7016,11 @@ HB_FUNC(DUK_BIND_FUNCTION)
 /* 創建新的函數 */
 HB_FUNC(DUK_PUSH_C_FUNCTION)
 {
-   const char *name = hb_parc(1);
-   duk_c_function func = (duk_c_function)hb_parptr(2);
-   duk_idx_t nargs = hb_parni(3);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   const char *name = hb_parc(iBase + 1);
+   duk_c_function func = (duk_c_function)hb_parptr(iBase + 2);
+   duk_idx_t nargs = hb_parni(iBase + 3);
 
    if (ctx == NULL)
    {
@@ -719,7 +7035,7 @@ HB_FUNC(DUK_PUSH_C_FUNCTION)
    }
 
    duk_push_c_function(ctx, func, nargs);
-   duk_put_global_string(ctx, name);
+   duk_put_global_lstring(ctx, name, hb_parclen(iBase + 1));
    hb_retl(HB_TRUE);
 }
 
@@ -732,8 +7048,11 @@ HB_FUNC(DUK_GET_FUNCTION_PARAM_COUNT)
 /* 設置對象枚舉器 */
 HB_FUNC(DUK_ENUM)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   duk_uint_t enum_flags = (duk_uint_t)hb_parni(2);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   duk_uint_t enum_flags = (duk_uint_t)hb_parni(iBase + 2);
 
    if (ctx == NULL)
    {
@@ -748,7 +7067,10 @@ HB_FUNC(DUK_ENUM)
 /* 獲取下一個枚舉項 */
 HB_FUNC(DUK_NEXT)
 {
-   duk_idx_t enum_idx = hb_parni(1);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t enum_idx = hb_parni(iBase + 1);
    duk_bool_t has_next = duk_next(ctx, enum_idx, 1);
    hb_retl(has_next);
 }
@@ -792,9 +7114,12 @@ HB_FUNC(DUK_IS_EXTENSIBLE)
 /* 設置對象屬性描述符 */
 HB_FUNC(DUK_DEFINE_PROPERTY)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   const char *key = hb_parc(2);
-   duk_uint_t flags = (duk_uint_t)hb_parni(3);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   const char *key = hb_parc(iBase + 2);
+   duk_uint_t flags = (duk_uint_t)hb_parni(iBase + 3);
 
    if (ctx == NULL)
    {
@@ -808,7 +7133,7 @@ HB_FUNC(DUK_DEFINE_PROPERTY)
       return;
    }
 
-   duk_push_string(ctx, key);
+   duk_push_lstring(ctx, key, hb_parclen(iBase + 2));
    duk_def_prop(ctx, obj_idx, flags);
    hb_retl(HB_TRUE);
 }
@@ -822,11 +7147,14 @@ HB_FUNC(DUK_GET_OWN_PROP_DESC)
 /* 設置對象屬性訪問器 */
 HB_FUNC(DUK_DEFINE_ACCESSOR)
 {
-   duk_idx_t obj_idx = hb_parni(1);
-   const char *key = hb_parc(2);
-   duk_c_function getter = (duk_c_function)hb_parptr(3);
-   duk_c_function setter = (duk_c_function)hb_parptr(4);
-   duk_uint_t flags = (duk_uint_t)hb_parni(5);
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   duk_idx_t obj_idx = hb_parni(iBase + 1);
+   const char *key = hb_parc(iBase + 2);
+   duk_c_function getter = (duk_c_function)hb_parptr(iBase + 3);
+   duk_c_function setter = (duk_c_function)hb_parptr(iBase + 4);
+   duk_uint_t flags = (duk_uint_t)hb_parni(iBase + 5);
 
    if (ctx == NULL)
    {
@@ -840,7 +7168,7 @@ HB_FUNC(DUK_DEFINE_ACCESSOR)
       return;
    }
 
-   duk_push_string(ctx, key);
+   duk_push_lstring(ctx, key, hb_parclen(iBase + 2));
    if (getter != NULL)
    {
       duk_push_c_function(ctx, getter, 0);
@@ -864,6 +7192,9 @@ HB_FUNC(DUK_DEFINE_ACCESSOR)
 /* 強制執行垃圾回收 */
 HB_FUNC(DUK_GC)
 {
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
    if (ctx == NULL)
    {
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
@@ -877,6 +7208,8 @@ HB_FUNC(DUK_GC)
 /* 設置垃圾回收回調函數 */
 HB_FUNC(DUK_SET_GC_CALLBACK)
 {
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
    const char *callback;
    const char *error;
 
@@ -886,14 +7219,14 @@ HB_FUNC(DUK_SET_GC_CALLBACK)
       return;
    }
 
-   callback = hb_parc(1);
+   callback = hb_parc(iBase + 1);
    if (callback == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_push_string(ctx, callback);
+   duk_push_lstring(ctx, callback, hb_parclen(iBase + 1));
    if (duk_peval(ctx) != 0)
    {
       error = duk_safe_to_string(ctx, -1);
@@ -906,10 +7239,13 @@ HB_FUNC(DUK_SET_GC_CALLBACK)
    hb_retl(HB_TRUE);
 }
 
-/* 獲取垃圾回收統計信息 */
+/* 獲取垃圾回收統計信息: { mark-and-sweep 次數, 累計暫停 (毫秒), 最長暫停 (毫秒),
+ *   引用計數釋放數, 對象數, 字符串數, 緩衝區數 } */
 HB_FUNC(DUK_GET_GC_STATS)
 {
-   duk_memory_functions funcs;
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+   duk_hb_gc_stats stats;
    PHB_ITEM pArray;
 
    if (ctx == NULL)
@@ -918,12 +7254,16 @@ HB_FUNC(DUK_GET_GC_STATS)
       return;
    }
 
-   duk_get_memory_functions(ctx, &funcs);
+   duk_hb_get_gc_stats(ctx, &stats);
 
-   pArray = hb_itemArrayNew(3);
-   hb_arraySetNInt(pArray, 1, (HB_PTRUINT)funcs.alloc_func);
-   hb_arraySetNInt(pArray, 2, (HB_PTRUINT)funcs.realloc_func);
-   hb_arraySetNInt(pArray, 3, (HB_PTRUINT)funcs.free_func);
+   pArray = hb_itemArrayNew(7);
+   hb_arraySetNInt(pArray, 1, (HB_MAXINT)stats.ms_count);
+   hb_arraySetND(pArray, 2, stats.ms_time_total);
+   hb_arraySetND(pArray, 3, stats.ms_time_max);
+   hb_arraySetNInt(pArray, 4, (HB_MAXINT)stats.refzero_free_count);
+   hb_arraySetNInt(pArray, 5, (HB_MAXINT)stats.count_object);
+   hb_arraySetNInt(pArray, 6, (HB_MAXINT)stats.count_string);
+   hb_arraySetNInt(pArray, 7, (HB_MAXINT)stats.count_buffer);
 
    hb_itemReturn(pArray);
    hb_itemRelease(pArray);
@@ -932,6 +7272,8 @@ HB_FUNC(DUK_GET_GC_STATS)
 /* 設置記憶體分配回調函數 */
 HB_FUNC(DUK_SET_ALLOC_CALLBACK)
 {
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
    const char *callback;
    const char *error;
 
@@ -941,14 +7283,14 @@ HB_FUNC(DUK_SET_ALLOC_CALLBACK)
       return;
    }
 
-   callback = hb_parc(1);
+   callback = hb_parc(iBase + 1);
    if (callback == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_push_string(ctx, callback);
+   duk_push_lstring(ctx, callback, hb_parclen(iBase + 1));
    if (duk_peval(ctx) != 0)
    {
       error = duk_safe_to_string(ctx, -1);
@@ -964,6 +7306,8 @@ HB_FUNC(DUK_SET_ALLOC_CALLBACK)
 /* 設置記憶體釋放回調函數 */
 HB_FUNC(DUK_SET_FREE_CALLBACK)
 {
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
    const char *callback;
    const char *error;
 
@@ -973,14 +7317,14 @@ HB_FUNC(DUK_SET_FREE_CALLBACK)
       return;
    }
 
-   callback = hb_parc(1);
+   callback = hb_parc(iBase + 1);
    if (callback == NULL)
    {
       hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_push_string(ctx, callback);
+   duk_push_lstring(ctx, callback, hb_parclen(iBase + 1));
    if (duk_peval(ctx) != 0)
    {
       error = duk_safe_to_string(ctx, -1);
@@ -993,24 +7337,305 @@ HB_FUNC(DUK_SET_FREE_CALLBACK)
    hb_retl(HB_TRUE);
 }
 
-/* 獲取記憶體分配統計信息 */
+/* 獲取記憶體分配統計信息: { 分配次數, 釋放次數, 重新分配次數, 失敗次數 } */
 HB_FUNC(DUK_GET_ALLOC_STATS)
 {
-   duk_memory_functions funcs;
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
    PHB_ITEM pArray;
 
-   if (ctx == NULL)
+   if (pDuk == NULL || pDuk->ctx == NULL)
    {
       hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
       return;
    }
 
-   duk_get_memory_functions(ctx, &funcs);
-
-   pArray = hb_itemArrayNew(2);
-   hb_arraySetNInt(pArray, 1, (HB_PTRUINT)funcs.alloc_func);
-   hb_arraySetNInt(pArray, 2, (HB_PTRUINT)funcs.free_func);
+   pArray = hb_itemArrayNew(4);
+   hb_arraySetNInt(pArray, 1, (HB_MAXINT)pDuk->nAllocs);
+   hb_arraySetNInt(pArray, 2, (HB_MAXINT)pDuk->nFrees);
+   hb_arraySetNInt(pArray, 3, (HB_MAXINT)pDuk->nReallocs);
+   hb_arraySetNInt(pArray, 4, (HB_MAXINT)pDuk->nAllocFails);
 
    hb_itemReturn(pArray);
    hb_itemRelease(pArray);
-} 
\ No newline at end of file
+} 
+
+/* 取樣分析器: 由執行器中斷鉤子調用 (duk_config.h 的 DUK_USE_HB_EXEC_SAMPLE),
+ * 約每 256K 條指令一次, 未啟用時只有一次指標檢查 */
+#define HB_DUK_PROFILE_STACK  4096
+
+void hb_duk_exec_sample(void *udata, void *thr)
+{
+   PHB_DUK pDuk = (PHB_DUK)udata;
+   char buf[HB_DUK_PROFILE_STACK];
+   duk_size_t len;
+   PHB_ITEM pKey, pCount;
+
+   if (pDuk == NULL || pDuk->pProfile == NULL || ++pDuk->iProfileTick < pDuk->iProfileEvery)
+   {
+      return;
+   }
+   pDuk->iProfileTick = 0;
+
+   len = duk_hb_sample_callstack((duk_context *)thr, buf, sizeof(buf));
+   pKey = hb_itemPutCL(NULL, buf, (HB_SIZE)len);
+   pCount = hb_hashGetItemPtr(pDuk->pProfile, pKey, 0);
+   if (pCount != NULL)
+   {
+      hb_itemPutNInt(pCount, hb_itemGetNInt(pCount) + 1);
+   }
+   else
+   {
+      pCount = hb_itemPutNInt(NULL, 1);
+      hb_hashAdd(pDuk->pProfile, pKey, pCount);
+      hb_itemRelease(pCount);
+   }
+   hb_itemRelease(pKey);
+}
+
+/* 開始取樣: DUK_PROFILE_START([hHeap,] [nEvery]), 清除之前的樣本
+ * nEvery 為每幾次執行器中斷取樣一次, 預設 1 */
+HB_FUNC(DUK_PROFILE_START)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   int iEvery = hb_parnidef(iBase + 1, 1);
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (iEvery < 1)
+   {
+      hb_errRT_BASE(EG_ARG, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   if (pDuk->pProfile != NULL)
+   {
+      hb_itemRelease(pDuk->pProfile);
+   }
+   pDuk->pProfile = hb_hashNew(NULL);
+   pDuk->iProfileEvery = iEvery;
+   pDuk->iProfileTick = 0;
+   hb_retl(HB_TRUE);
+}
+
+/* 停止取樣: DUK_PROFILE_STOP([hHeap,] [cFile])
+ * 返回 { 折疊堆疊 => 樣本數 }; 指定 cFile 時寫入 flamegraph.pl 等工具使用的
+ * 折疊堆疊文本, 每行為 "外層 (文件:行);內層 (文件:行) 樣本數" */
+HB_FUNC(DUK_PROFILE_STOP)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   const char *filename;
+   PHB_ITEM pProfile;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   filename = hb_parc(iBase + 1);
+   pProfile = pDuk->pProfile;
+   pDuk->pProfile = NULL;
+   if (pProfile == NULL)
+   {
+      pProfile = hb_hashNew(NULL);
+   }
+
+   if (filename != NULL)
+   {
+      HB_SIZE nLen = hb_hashLen(pProfile), n, nText = 0, nMax = 4096;
+      char *text = (char *)hb_xgrab(nMax);
+      HB_BOOL fOK;
+
+      for (n = 1; n <= nLen; n++)
+      {
+         PHB_ITEM pKey = hb_hashGetKeyAt(pProfile, n);
+         HB_SIZE nKey = hb_itemGetCLen(pKey);
+         char num[32];
+         int iNum = hb_snprintf(num, sizeof(num), " %" PFHL "d\n", hb_itemGetNInt(hb_hashGetValueAt(pProfile, n)));
+
+         if (nText + nKey + iNum > nMax)
+         {
+            nMax = (nText + nKey + iNum) * 2;
+            text = (char *)hb_xrealloc(text, nMax);
+         }
+         memcpy(text + nText, hb_itemGetCPtr(pKey), nKey);
+         memcpy(text + nText + nKey, num, iNum);
+         nText += nKey + iNum;
+      }
+      fOK = hb_duk_file_store(filename, text, nText, NULL, 0);
+      hb_xfree(text);
+      if (!fOK)
+      {
+         hb_itemRelease(pProfile);
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+   }
+
+   hb_itemReturnRelease(pProfile);
+}
+
+#if defined(DUK_USE_HB_OPCODE_STATS)
+static duk_ret_t hb_duk_exec_stats_raw(duk_context *ctx, void *udata)
+{
+   duk_hb_push_exec_stats(ctx, *(duk_bool_t *)udata);
+   return 1;
+}
+#endif
+
+/* 執行統計: DUK_EXEC_STATS([hHeap,] [lReset])
+ * 返回 { "opcodes" => { 指令名 => 次數 }, "functions" => { "函數 (文件:行)" => 指令數 },
+ *   "collected" => 已回收函數的指令數 }; 需以 HB_DUK_OPCODE_STATS 編譯, 否則返回 NIL */
+HB_FUNC(DUK_EXEC_STATS)
+{
+   int iBase;
+   duk_context *ctx = hb_duk_ctx(&iBase);
+
+   if (ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+#if defined(DUK_USE_HB_OPCODE_STATS)
+   {
+      duk_bool_t fReset = (duk_bool_t)hb_parl(iBase + 1);
+
+      /* 收集時的分配失敗以 Harbour 錯誤返回 */
+      if (duk_safe_call(ctx, hb_duk_exec_stats_raw, &fReset, 0, 1) != DUK_EXEC_SUCCESS)
+      {
+         duk_pop(ctx);
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         return;
+      }
+      if (!hb_duk_get_item_safe(ctx, -1, hb_stackReturnItem()))
+      {
+         hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+         duk_pop(ctx);
+      }
+      duk_pop(ctx);
+   }
+#else
+   HB_SYMBOL_UNUSED(iBase);
+   hb_ret();
+#endif
+}
+
+/* 啟用或停用延遲直方圖: DUK_LATENCY_ENABLE([hHeap,] [lOn]), 返回先前狀態
+ * 啟用後記錄 DUK_EVAL* (以源碼雜湊命名), DUK_CALL_FUNCTION*, DUK_CALL_HANDLE 及
+ * Harbour 回調的執行時間; 停用時捨棄已收集的數據 */
+HB_FUNC(DUK_LATENCY_ENABLE)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   HB_BOOL fOn = hb_parldef(iBase + 1, HB_TRUE);
+   HB_BOOL fPrev;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   fPrev = pDuk->pLatency != NULL;
+   if (fOn && !fPrev)
+   {
+      hb_duk_lat_start(pDuk);
+   }
+   else if (!fOn)
+   {
+      hb_duk_lat_free(pDuk);
+   }
+   hb_retl(fPrev);
+}
+
+static void hb_duk_hash_set(PHB_ITEM pHash, const char *szKey, PHB_ITEM pValue)
+{
+   PHB_ITEM pKey = hb_itemPutC(NULL, szKey);
+
+   hb_hashAdd(pHash, pKey, pValue);
+   hb_itemRelease(pKey);
+   hb_itemRelease(pValue);
+}
+
+/* 直方圖中第 dQuantile 分位的值 (分格上限, 不超過最大值) */
+static HB_MAXUINT hb_duk_lat_quantile(HB_DUK_LAT *pLat, double dQuantile)
+{
+   HB_MAXUINT nRank = (HB_MAXUINT)(dQuantile * (double)pLat->nCount + 0.999999), nSeen = 0;
+   int i;
+
+   if (nRank < 1)
+   {
+      nRank = 1;
+   }
+   for (i = 0; i < HB_DUK_LAT_BUCKETS; i++)
+   {
+      nSeen += pLat->nBuckets[i];
+      if (nSeen >= nRank)
+      {
+         HB_MAXUINT nHigh = hb_duk_lat_bucket_high(i);
+
+         return nHigh < pLat->nMax ? nHigh : pLat->nMax;
+      }
+   }
+   return pLat->nMax;
+}
+
+/* 延遲快照: DUK_LATENCY_SNAPSHOT([hHeap,] [lReset])
+ * 返回 { 名稱 => { "count", "min", "max", "mean", "p50", "p90", "p99", "p999" } }, 單位為微秒;
+ * lReset 為真時清除已收集的數據 */
+HB_FUNC(DUK_LATENCY_SNAPSHOT)
+{
+   int iBase;
+   PHB_DUK pDuk = hb_duk_param(&iBase);
+   PHB_ITEM pResult;
+   int i;
+
+   if (pDuk == NULL || pDuk->ctx == NULL)
+   {
+      hb_errRT_BASE(EG_CREATE, 2010, NULL, HB_ERR_FUNCNAME, HB_ERR_ARGS_BASEPARAMS);
+      return;
+   }
+
+   pResult = hb_hashNew(NULL);
+   if (pDuk->pLatency != NULL)
+   {
+      for (i = 0; i < HB_DUK_LAT_TABLE; i++)
+      {
+         HB_DUK_LAT *pLat;
+
+         for (pLat = pDuk->pLatency[i]; pLat != NULL; pLat = pLat->pNext)
+         {
+            PHB_ITEM pStats = hb_hashNew(NULL);
+            PHB_ITEM pKey;
+
+            hb_duk_hash_set(pStats, "count", hb_itemPutNInt(NULL, (HB_MAXINT)pLat->nCount));
+            hb_duk_hash_set(pStats, "min", hb_itemPutNInt(NULL, (HB_MAXINT)pLat->nMin));
+            hb_duk_hash_set(pStats, "max", hb_itemPutNInt(NULL, (HB_MAXINT)pLat->nMax));
+            hb_duk_hash_set(pStats, "mean", hb_itemPutND(NULL, (double)pLat->nSum / (double)pLat->nCount));
+            hb_duk_hash_set(pStats, "p50", hb_itemPutNInt(NULL, (HB_MAXINT)hb_duk_lat_quantile(pLat, 0.5)));
+            hb_duk_hash_set(pStats, "p90", hb_itemPutNInt(NULL, (HB_MAXINT)hb_duk_lat_quantile(pLat, 0.9)));
+            hb_duk_hash_set(pStats, "p99", hb_itemPutNInt(NULL, (HB_MAXINT)hb_duk_lat_quantile(pLat, 0.99)));
+            hb_duk_hash_set(pStats, "p999", hb_itemPutNInt(NULL, (HB_MAXINT)hb_duk_lat_quantile(pLat, 0.999)));
+
+            pKey = hb_itemPutCL(NULL, pLat->szName, pLat->nLen);
+            hb_hashAdd(pResult, pKey, pStats);
+            hb_itemRelease(pKey);
+            hb_itemRelease(pStats);
+         }
+      }
+      if (hb_parl(iBase + 1))
+      {
+         hb_duk_lat_start(pDuk);
+      }
+   }
+
+   hb_itemReturnRelease(pResult);
+}